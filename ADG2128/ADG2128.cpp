@@ -24,12 +24,23 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include "ADG2128.h"
+#include <string.h>
 
 const int8_t ADG2128::ADG2128_ERROR_NO_ERROR         = 0; 
 const int8_t ADG2128::ADG2128_ERROR_ABSENT           = -1;
 const int8_t ADG2128::ADG2128_ERROR_BUS              = -2;
 const int8_t ADG2128::ADG2128_ERROR_BAD_COLUMN       = -3;   // Column was out-of-bounds.
 const int8_t ADG2128::ADG2128_ERROR_BAD_ROW          = -4;   // Row was out-of-bounds.
+const int8_t ADG2128::ADG2128_ERROR_IN_BATCH         = -5;   // A batch is already open.
+
+const uint8_t ADG2128::ADG2128_COHERENCE_TRUST_SHADOW     = 0;
+const uint8_t ADG2128::ADG2128_COHERENCE_VERIFY_ON_DEMAND = 1;
+const uint8_t ADG2128::ADG2128_COHERENCE_VERIFY_PERIODIC  = 2;
+
+/*
+* Readback on this part is organized by rows. These are the sub-addresses that select each one.
+*/
+const uint16_t ADG2128::readback_addr[12] = {0x3400, 0x3b00, 0x7400, 0x7b00, 0x3500, 0x3D00, 0x7500, 0x7D00, 0x3600, 0x3E00, 0x7600, 0x7E00};
 
 
 #include "../Logger/Logger.h"
@@ -52,17 +63,29 @@ extern I2CAdapter *i2c;
 
 
 /*
-* Constructor. Takes the i2c address of this device as sole argument.
+* Constructor. Takes the i2c address of this device, and optionally the bus it is on.
 */
-ADG2128::ADG2128(uint8_t i2c_addr) {
+ADG2128::ADG2128(uint8_t i2c_addr, I2CAdapter* adapter) {
 	I2C_ADDRESS = i2c_addr;
+	bus         = (NULL != adapter) ? adapter : i2c;
 	preserve_state_on_destroy = false;
 	dev_init = false;
+	batch_open  = false;
+	batch_count = 0;
+	defer_latch   = false;
+	latch_pending = false;
+	latch_failed  = false;
+	coherence        = ADG2128_COHERENCE_TRUST_SHADOW;
+	coherence_period = 0;
+	last_refresh     = 0;
+	memset(values, 0x00, sizeof(values));
 	init();
 }
 
 ADG2128::~ADG2128(void) {
+	settle();   // The bus thread might still call us back.
 	if (!preserve_state_on_destroy) {
+		abortBatch();
 		reset();
 	}
 }
@@ -72,35 +95,55 @@ ADG2128::~ADG2128(void) {
 * 
 */
 int8_t ADG2128::init(void) {
-	if ((i2c == NULL) || (!i2c->busOnline())) {
+	if ((bus == NULL) || (!bus->busOnline())) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
 		dev_init = false;
 		return ADG2128_ERROR_BUS;
 	}
-	for (int i = 0; i < 12; i++) {
-		if (readback(i) != ADG2128_ERROR_NO_ERROR) {
-			dev_init = false;
-			logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to init switch.");
-			return ADG2128_ERROR_BUS;
-		}
+	if (refresh() != ADG2128_ERROR_NO_ERROR) {
+		dev_init = false;
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to init switch.");
+		return ADG2128_ERROR_BUS;
 	}
 	dev_init = true;
 	return ADG2128_ERROR_NO_ERROR;
 }
 
 
+bool ADG2128::initialized(void) {
+	return dev_init;
+}
+
+
+    
+/*
+* The first byte of a switch write: DATA, then the X (row) and Y (column) addresses.
+*   Rows 6-11 live at X addresses 8-13. The second byte carries LDSW.
+*/
+uint8_t ADG2128::switch_byte(uint8_t col, uint8_t row, bool on) {
+	uint8_t safe_row = row;
+	if (safe_row >= 6) safe_row = safe_row + 2;
+	return ((on ? 0x80 : 0x00) + (safe_row << 3) + col);
+}
+
+
+void ADG2128::switch_coords(uint8_t cmd, uint8_t *col, uint8_t *row) {
+	*col = cmd & 0x07;
+	*row = (cmd >> 3) & 0x0F;
+	if (*row >= 8) *row = *row - 2;
+}
+
     
 int8_t ADG2128::setRoute(uint8_t col, uint8_t row) {
 	if (col > 7)  return ADG2128_ERROR_BAD_COLUMN;
 	if (row > 11) return ADG2128_ERROR_BAD_ROW;
-	if ((i2c == NULL) || (!i2c->busOnline())) {
+	if (batch_open) return stage(col, row, true);
+	if ((bus == NULL) || (!bus->busOnline())) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
 		return ADG2128_ERROR_BUS;
 	}
-	uint8_t safe_row = row;
-	if (safe_row >= 6) safe_row = safe_row + 2;
-	uint16_t val = 0x01 + ((0x80 + (safe_row << 3) + col) << 8);
-	if (i2c->write16(I2C_ADDRESS, val) <= 0) {
+	uint16_t val = 0x01 + (switch_byte(col, row, true) << 8);
+	if (bus->write16(I2C_ADDRESS, val) <= 0) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write new value.");
 		return ADG2128_ERROR_BUS;
 	}
@@ -112,14 +155,13 @@ int8_t ADG2128::setRoute(uint8_t col, uint8_t row) {
 int8_t ADG2128::unsetRoute(uint8_t col, uint8_t row) {
 	if (col > 7)  return ADG2128_ERROR_BAD_COLUMN;
 	if (row > 11) return ADG2128_ERROR_BAD_ROW;
-	if ((i2c == NULL) || (!i2c->busOnline())) {
+	if (batch_open) return stage(col, row, false);
+	if ((bus == NULL) || (!bus->busOnline())) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
 		return ADG2128_ERROR_BUS;
 	}
-	uint8_t safe_row = row;
-	if (safe_row >= 6) safe_row = safe_row + 2;
-	uint16_t val = 0x01 + ((0x00 + (safe_row << 3) + col) << 8);
-	if (i2c->write16(I2C_ADDRESS, val) <= 0) {
+	uint16_t val = 0x01 + (switch_byte(col, row, false) << 8);
+	if (bus->write16(I2C_ADDRESS, val) <= 0) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write new value.");
 		return ADG2128_ERROR_BUS;
 	}
@@ -128,23 +170,231 @@ int8_t ADG2128::unsetRoute(uint8_t col, uint8_t row) {
 }
 
 
+int8_t ADG2128::beginBatch(void) {
+	if (batch_open) return ADG2128_ERROR_IN_BATCH;
+	settle();   // batch[] might still be holding the last one.
+	batch_open  = true;
+	batch_count = 0;
+	return ADG2128_ERROR_NO_ERROR;
+}
+
+
+bool ADG2128::inBatch(void) {
+	return batch_open;
+}
+
+
+void ADG2128::abortBatch(void) {
+	batch_open  = false;
+	batch_count = 0;
+}
+
+
+/*
+* A later change to the same crosspoint replaces the earlier one in place. So the
+*   batch never holds more than one entry per switch.
+*/
+int8_t ADG2128::stage(uint8_t col, uint8_t row, bool on) {
+	uint8_t cmd = switch_byte(col, row, on);
+	for (uint8_t i = 0; i < batch_count; i++) {
+		if ((batch[i] & 0x7F) == (cmd & 0x7F)) {
+			batch[i] = cmd;
+			return ADG2128_ERROR_NO_ERROR;
+		}
+	}
+	batch[batch_count++] = cmd;
+	return ADG2128_ERROR_NO_ERROR;
+}
+
+
+int8_t ADG2128::commitBatch(void) {
+	if (!batch_open) return ADG2128_ERROR_NO_ERROR;
+	batch_open = false;
+	int8_t return_value = send_batch();
+	if (!latch_pending) batch_count = 0;
+	return return_value;
+}
+
+
+void ADG2128::deferLatch(bool x) {
+	defer_latch = x;
+}
+
+
+/*
+* Called on the bus thread as each piece of a deferred batch finishes.
+*/
+void ADG2128::latch_done(I2CTransaction* txn, void* arg) {
+	ADG2128* self = (ADG2128*) arg;
+	if (txn->result != txn->seg_count) __atomic_store_n(&self->latch_failed, true, __ATOMIC_RELEASE);
+}
+
+
+/*
+* If a deferred latch failed, the shadow we updated when it was queued is wrong, and
+*   the input register may be holding some of the batch. Both are put right before we
+*   report it.
+*/
+int8_t ADG2128::settle(void) {
+	if (!latch_pending) return ADG2128_ERROR_NO_ERROR;
+	latch_pending = false;
+	int8_t return_value = ADG2128_ERROR_NO_ERROR;
+#ifndef ARDUINO
+	bus->drain();
+	if (__atomic_exchange_n(&latch_failed, false, __ATOMIC_ACQ_REL)) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "A queued batch of %d switch changes failed.", batch_count);
+		refresh();
+		restore_input(batch_count);
+		return_value = ADG2128_ERROR_BUS;
+	}
+#endif
+	batch_count = 0;
+	return return_value;
+}
+
+
+/*
+* Everything goes out as combined transactions (as few as the segment limit allows).
+*   Only the final write sets LDSW. If we fail before getting that far, nothing held
+*   has taken effect, so we try to put the input register back the way the switches
+*   actually are before giving up. Otherwise the next latch would pick up the leftovers.
+* Each transaction waits for its result, even if the bus has a worker. The caller is
+*   told the switch moved only once it has. Unless the latch is deferred: then the
+*   batch is queued on the bus thread, the shadow assumes it landed, and settle()
+*   finds out whether it did. That lets several switches on different buses latch at
+*   the same time.
+*/
+int8_t ADG2128::send_batch(void) {
+	if (batch_count == 0) return ADG2128_ERROR_NO_ERROR;
+	if ((bus == NULL) || (!bus->busOnline())) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
+		return ADG2128_ERROR_BUS;
+	}
+	bool deferred = false;
+#ifndef ARDUINO
+	deferred = defer_latch && bus->workerRunning();
+#endif
+	I2CTransaction txn;
+	uint8_t i = 0;
+	while (i < batch_count) {
+		txn.clear();
+		while ((i < batch_count) && !txn.full(1, 2)) {
+			uint8_t ldsw = ((i + 1) == batch_count) ? 0x01 : 0x00;
+			txn.addWrite16(I2C_ADDRESS, (batch[i] << 8) + ldsw);
+			i++;
+		}
+		if (deferred) {
+			txn.callback     = ADG2128::latch_done;
+			txn.callback_arg = (void*) this;
+		}
+		if (bus->transact(&txn, !deferred) < 0) {
+			logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to send a batch of %d switch changes.", batch_count);
+			if (deferred) {
+				// Some of it may already be queued. Let that finish before we undo it.
+				latch_pending = true;
+				__atomic_store_n(&latch_failed, true, __ATOMIC_RELEASE);
+				settle();
+			}
+			else {
+				restore_input(i);
+			}
+			return ADG2128_ERROR_BUS;
+		}
+	}
+	latch_pending = deferred;
+
+	// The latch went out. Our shadow can now reflect the switch.
+	for (i = 0; i < batch_count; i++) {
+		uint8_t r, c;
+		switch_coords(batch[i], &c, &r);
+		if (batch[i] & 0x80) values[r] = values[r] | (0x01 << c);
+		else                 values[r] = values[r] & ~(0x01 << c);
+	}
+	return ADG2128_ERROR_NO_ERROR;
+}
+
+
+/*
+* Put the first <count> held changes back the way the shadow says the switches are,
+*   without latching. Best effort. We are already failing.
+*/
+void ADG2128::restore_input(uint8_t count) {
+	I2CTransaction txn;
+	uint8_t j = 0;
+	while (j < count) {
+		txn.clear();
+		while ((j < count) && !txn.full(1, 2)) {
+			uint8_t r, c;
+			switch_coords(batch[j], &c, &r);
+			txn.addWrite16(I2C_ADDRESS, switch_byte(c, r, (values[r] >> c) & 0x01) << 8);
+			j++;
+		}
+		bus->transact(&txn, true);
+	}
+}
+
+
 void ADG2128::preserveOnDestroy(bool x) {
 	preserve_state_on_destroy = x;
 }
 
 
 /*
-* Opens all switches.
+* Opens all switches. Only the ones that are actually closed get written. This
+*   happens now, so it can't be part of somebody's batch.
 */
 int8_t ADG2128::reset(void) {
-	for (int i = 0; i < 12; i++) {
-		for (int j = 0; j < 8; j++) {
-			if (unsetRoute(j, i) != ADG2128_ERROR_NO_ERROR) {
-				return ADG2128_ERROR_BUS;
-			}
+	if (batch_open) return ADG2128_ERROR_IN_BATCH;
+	if (!dev_init) {
+		// We can't diff against a shadow we never filled.
+		int8_t result = init();
+		if (result != ADG2128_ERROR_NO_ERROR) return result;
+	}
+	uint8_t open_matrix[12];
+	memset(open_matrix, 0x00, sizeof(open_matrix));
+	return setMatrix(open_matrix);
+}
+
+
+/*
+* Compares the target against the shadow and sends only the difference. All the
+*   opens are sent before any of the closes (break-before-make), and the whole change
+*   lands on a single latch. If a batch is already open, the difference is taken from
+*   where that batch leaves the switch. It is added to the batch, and the caller's
+*   commitBatch() does the sending.
+*/
+int8_t ADG2128::setMatrix(const uint8_t target[12]) {
+	bool own_batch = !batch_open;
+	if (own_batch) beginBatch();
+
+	uint8_t current[12];
+	memcpy(current, values, sizeof(current));
+	for (uint8_t i = 0; i < batch_count; i++) {
+		uint8_t r, c;
+		switch_coords(batch[i], &c, &r);
+		if (batch[i] & 0x80) current[r] = current[r] | (0x01 << c);
+		else                 current[r] = current[r] & ~(0x01 << c);
+	}
+
+	for (uint8_t row = 0; row < 12; row++) {
+		uint8_t opening = current[row] & ~target[row];
+		for (uint8_t col = 0; col < 8; col++) {
+			if ((opening >> col) & 0x01) stage(col, row, false);
+		}
+	}
+	for (uint8_t row = 0; row < 12; row++) {
+		uint8_t closing = target[row] & ~current[row];
+		for (uint8_t col = 0; col < 8; col++) {
+			if ((closing >> col) & 0x01) stage(col, row, true);
 		}
 	}
-	return init();
+
+	return (own_batch ? commitBatch() : ADG2128_ERROR_NO_ERROR);
+}
+
+
+void ADG2128::getMatrix(uint8_t dest[12]) {
+	memcpy(dest, values, sizeof(values));
 }
 
 
@@ -152,37 +402,88 @@ int8_t ADG2128::reset(void) {
 * Readback on this part is organized by rows, with the return bits
 * being the state of the switches to the ocrresponding column.
 * The readback address table is hard-coded in the readback_addr array.
+* This reads a single row. refresh() reads them all at once.
 *
 *
 */
 int8_t ADG2128::readback(uint8_t row) {
 	if (row > 11) return ADG2128_ERROR_BAD_ROW;
-	if ((i2c == NULL) || (!i2c->busOnline())) {
+	if ((bus == NULL) || (!bus->busOnline())) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
 		return ADG2128_ERROR_BUS;
 	}
-	uint16_t readback_addr[12] = {0x3400, 0x3b00, 0x7400, 0x7b00, 0x3500, 0x3D00, 0x7500, 0x7D00, 0x3600, 0x3E00, 0x7600, 0x7E00};
-	//i2c->write16(I2C_ADDRESS, readback_addr[row]);
-	uint16_t val = 0;
-	val = i2c->read16(I2C_ADDRESS, readback_addr[row]);
-	if (!i2c->bus_error) {
-		values[row] = (uint8_t) val;
-	}
-	else {
+	// busError() belongs to whichever transaction on the bus finished last, which may
+	//   not be ours. So we go by the result of our own.
+	uint8_t buf[2];
+	I2CTransaction txn;
+	txn.addWrite16(I2C_ADDRESS, readback_addr[row]);
+	txn.addRead(I2C_ADDRESS, buf, 2);
+	if (bus->transact(&txn) < 0) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus error while reading readback address %d.", row);
 		return ADG2128_ERROR_ABSENT;
 	}
+	values[row] = buf[1];
+	return ADG2128_ERROR_NO_ERROR;
+}
+
+
+/*
+* All twelve readback selections and their reads go out as one combined transaction,
+*   and the shadow is only touched if the whole thing succeeded.
+*/
+int8_t ADG2128::refresh(void) {
+	if ((bus == NULL) || (!bus->busOnline())) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus not ready.");
+		return ADG2128_ERROR_BUS;
+	}
+	uint8_t rows[12][2];
+	I2CTransaction txn;
+	for (int i = 0; i < 12; i++) {
+		txn.addWrite16(I2C_ADDRESS, readback_addr[i]);
+		txn.addRead(I2C_ADDRESS, rows[i], 2);
+	}
+	if (bus->transact(&txn) < 0) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Bus error while reading back the switch.");
+		return ADG2128_ERROR_ABSENT;
+	}
+	for (int i = 0; i < 12; i++) {
+		values[i] = rows[i][1];
+	}
+	last_refresh = millis();
 	return ADG2128_ERROR_NO_ERROR;
 }
 
 
+/*
+* Every write we make goes through the shadow, so unless something else is talking
+*   to the switch, the shadow is the truth. How much we verify that is up to the
+*   coherence policy.
+*/
 uint8_t ADG2128::getValue(uint8_t row) {
 	if (row > 11) return ADG2128_ERROR_BAD_ROW;
-	readback(row);
+	if (coherence == ADG2128_COHERENCE_VERIFY_ON_DEMAND) {
+		readback(row);
+	}
+	else if (coherence == ADG2128_COHERENCE_VERIFY_PERIODIC) {
+		if ((unsigned long) (millis() - last_refresh) >= coherence_period) {
+			refresh();
+		}
+	}
 	return values[row];
 }
 
 
+void ADG2128::setCoherence(uint8_t policy, uint32_t period_ms) {
+	coherence        = (policy > ADG2128_COHERENCE_VERIFY_PERIODIC) ? ADG2128_COHERENCE_TRUST_SHADOW : policy;
+	coherence_period = period_ms;
+}
+
+
+uint8_t ADG2128::getCoherence(void) {
+	return coherence;
+}
+
+
 void ADG2128::dumpToLog(void) {
 	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Device i2c address is 0x%02x", I2C_ADDRESS);
 	if (dev_init) {
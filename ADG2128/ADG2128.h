@@ -40,34 +40,88 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 * The 8-pin group are the columns, and the 12-pin group are rows. 
 */
 
+class I2CAdapter;
+class I2CTransaction;
+
 class ADG2128 {
   public:
-    ADG2128(uint8_t i2c_addr);
+    ADG2128(uint8_t i2c_addr, I2CAdapter* bus = NULL);   // If no bus is given, we use the global one.
     ~ADG2128(void);
 
     int8_t init(void);                            // Perform bus-related init tasks.
+    bool   initialized(void);                     // Did the last init() succeed?
     void preserveOnDestroy(bool);
                                  
     int8_t setRoute(uint8_t col, uint8_t row);    // Sets a route between two pins. Returns error code.
     int8_t unsetRoute(uint8_t col, uint8_t row);  // Unsets a route between two pins. Returns error code.
-    int8_t reset(void);                           // Resets the entire device.
+    int8_t reset(void);                           // Resets the entire device. Refused during a batch.
+
+    // Batched changes. Between beginBatch() and commitBatch(), setRoute() and unsetRoute()
+    //   are held in memory. The commit sends them all with LDSW clear, except the last,
+    //   which latches the whole lot into the switch at once.
+    int8_t beginBatch(void);
+    int8_t commitBatch(void);                     // Returns error code. The batch is finished either way.
+    void   abortBatch(void);                      // Forget any held changes.
+    bool   inBatch(void);
+
+    // If deferred, and the bus has a worker, commitBatch() only queues the latch and
+    //   reports success. settle() waits for it, and says whether it really landed.
+    void   deferLatch(bool);
+    int8_t settle(void);
+
+    // Whole-matrix operations. One byte per row, bit n is column n.
+    int8_t setMatrix(const uint8_t target[12]);   // Move to the given state, writing only the switches that change.
+    void   getMatrix(uint8_t dest[12]);           // Copy out our idea of the present state.
                            
-    uint8_t getValue(uint8_t row);
+    uint8_t getValue(uint8_t row);                // Subject to the coherence policy.
+    int8_t refresh(void);                         // Read the whole switch back into the shadow.
     void dumpToLog(void);
 
+    // How much we trust our shadow of the switch when asked for its state.
+    void setCoherence(uint8_t policy, uint32_t period_ms);
+    uint8_t getCoherence(void);
+
+    static const uint8_t ADG2128_COHERENCE_TRUST_SHADOW;     // Reads come from memory. Only refresh() touches the bus.
+    static const uint8_t ADG2128_COHERENCE_VERIFY_ON_DEMAND; // Every getValue() reads its row back from the switch.
+    static const uint8_t ADG2128_COHERENCE_VERIFY_PERIODIC;  // getValue() calls refresh() if the shadow is older than the period.
+
     static const int8_t ADG2128_ERROR_NO_ERROR;    // There was no error.
     static const int8_t ADG2128_ERROR_ABSENT;      // The ADG2128 appears to not be connected to the bus.
     static const int8_t ADG2128_ERROR_BUS;         // The ADG2128 appears to not be connected to the bus.
     static const int8_t ADG2128_ERROR_BAD_COLUMN;  // Column was out-of-bounds.
     static const int8_t ADG2128_ERROR_BAD_ROW;     // Row was out-of-bounds.
+    static const int8_t ADG2128_ERROR_IN_BATCH;    // A batch is already open.
 
     
   private:
     uint8_t I2C_ADDRESS;
+    I2CAdapter* bus;
     bool    dev_init;
     bool preserve_state_on_destroy;
     uint8_t values[12];
 
+    uint8_t  coherence;
+    uint32_t coherence_period;                    // ms. Only used by ADG2128_COHERENCE_VERIFY_PERIODIC.
+    unsigned long last_refresh;                   // millis() at the end of the last successful refresh().
+
+    bool    batch_open;
+    uint8_t batch_count;
+    uint8_t batch[96];                            // Held changes, in order. Bit 7 is DATA, then row and column.
+
+    bool    defer_latch;
+    bool    latch_pending;                        // A deferred batch is still on the bus. batch[] holds it until settle().
+    bool    latch_failed;                         // Set from the bus thread. Only touch it atomically.
+
     int8_t readback(uint8_t row);
+    int8_t stage(uint8_t col, uint8_t row, bool on);
+    int8_t send_batch(void);
+    void   restore_input(uint8_t count);
+
+    static void latch_done(I2CTransaction*, void*);
+
+    static const uint16_t readback_addr[12];
+
+    static uint8_t switch_byte(uint8_t col, uint8_t row, bool on);
+    static void    switch_coords(uint8_t cmd, uint8_t *col, uint8_t *row);
 };
 #endif
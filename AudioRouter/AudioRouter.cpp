@@ -32,55 +32,77 @@ extern IansLogger logger;
 
 #include <string.h>
 
+#ifndef ARDUINO
+  #include "../i2c-adapter/i2c-adapter.h"    // For millis().
+#endif
+
 /*
 * To facilitate cheap (2-layer) PCB layouts, the pots are not mapped in an ordered manner to the
 * switch outputs. This lookup table allows us to forget that fact.
 */
 const uint8_t AudioRouter::col_remap[8] = {0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04};
 
+/*
+* ...and this is the same mapping in the other direction: switch column to output.
+*/
+const uint8_t AudioRouter::col_unmap[8] = {0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04};
+
 
 
 /*
-* Constructor. Here is all of the setup work. Takes the i2c addresses of the hardware as arguments.
+* Constructor. Here is all of the setup work. Takes the i2c addresses of the hardware as arguments,
+*   and optionally the bus the PCB is on. If no bus is given, the global one is used.
 */
-AudioRouter::AudioRouter(uint8_t cp_addr, uint8_t dp_lo_addr, uint8_t dp_hi_addr) {
+AudioRouter::AudioRouter(uint8_t cp_addr, uint8_t dp_lo_addr, uint8_t dp_hi_addr, I2CAdapter* bus) {
 	i2c_addr_cp_switch = cp_addr;
 	i2c_addr_dp_lo = dp_lo_addr;
 	i2c_addr_dp_hi = dp_hi_addr;
 	
-    cp_switch    = new ADG2128(cp_addr);
-    dp_lo        = new ISL23345(dp_lo_addr);
-    dp_hi        = new ISL23345(dp_hi_addr);
+    cp_switch    = new ADG2128(cp_addr, bus);
+    pots[0]      = new ISL23345(dp_lo_addr, bus);
+    pots[1]      = new ISL23345(dp_hi_addr, bus);
     
     for (uint8_t i = 0; i < 12; i++) {   // Setup our input channels.
-      inputs[i] = (CPInputChannel*) malloc(sizeof(CPInputChannel));
-      inputs[i]->cp_row   = i;
-      inputs[i]->name     = NULL;
+      inputs[i].cp_row   = i;
+      inputs[i].name     = NULL;
+      fanout[i]          = 0;
     }
 
     for (uint8_t i = 0; i < 8; i++) {    // Setup our output channels.
-      outputs[i] = (CPOutputChannel*) malloc(sizeof(CPOutputChannel));
-      outputs[i]->cp_column = col_remap[i];
-      outputs[i]->cp_row    = NULL;
-      outputs[i]->name      = NULL;
-      outputs[i]->dp_dev    = (i < 4) ? dp_lo : dp_hi;
-      outputs[i]->dp_reg    = i % 4;
-      outputs[i]->dp_val    = 128;
+      outputs[i].cp_column = col_remap[i];
+      outputs[i].cp_row    = AUDIO_ROUTER_UNBOUND;
+      outputs[i].name      = NULL;
+      outputs[i].dp_chip   = i / 4;
+      outputs[i].dp_reg    = i % 4;
+      outputs[i].dp_val    = 128;
+      ramps[i].active       = false;
+    }
+    for (uint8_t i = 0; i < AUDIO_ROUTER_MAX_SCENES; i++) {
+      scenes[i].used       = false;
+      scenes[i].plan.valid = false;
     }
+    last_tick   = 0;
+    ramp_period = AUDIO_ROUTER_RAMP_PERIOD_MS;
+    batch_open  = false;
+    snap_gen    = 0;
+    memset(snaps, 0x00, sizeof(snaps));
+    change_head = 0;
+    change_tail = 0;
+    evicted_gen = 0;
     
-    if (init() != AUDIO_ROUTER_ERROR_NO_ERROR) {
+    // The chips have just read themselves back in their own constructors. Doing it
+    //   again would only double the bus traffic.
+    if (init_chips(false) != AUDIO_ROUTER_ERROR_NO_ERROR) {
     	logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Tried to init AudioRouter and failed.");
     }
+    publish();
 }
 
 AudioRouter::~AudioRouter() {
-    for (uint8_t i = 0; i < 12; i++) free(inputs[i]);
-    for (uint8_t i = 0; i < 8; i++)  free(outputs[i]);
-
     // Destroy the objects that represeent our hardware. Downstream operations will
     //   put the hardware into an inert state, so that needn't be done here.
-	if (dp_lo != NULL)     delete dp_lo;
-	if (dp_hi != NULL)     delete dp_hi;
+	if (pots[0] != NULL)   delete pots[0];
+	if (pots[1] != NULL)   delete pots[1];
 	if (cp_switch != NULL) delete cp_switch;
 }
 
@@ -89,17 +111,27 @@ AudioRouter::~AudioRouter() {
 * Do all the bus-related init.
 */
 int8_t AudioRouter::init(void) {
-	int8_t result = dp_lo->init();
+	int8_t result = init_chips(true);
+	publish();
+	return result;
+}
+
+
+/*
+* Unless told to re-read everything, chips that already came up are left alone.
+*/
+int8_t AudioRouter::init_chips(bool reread) {
+	int8_t result = (reread || !pots[0]->initialized()) ? pots[0]->init() : 0;
 	if (result != 0) {
 		printf("Failed to init() dp_lo (0x%02x) with cause (%d).", i2c_addr_dp_lo, result);
 		return AUDIO_ROUTER_ERROR_BUS;
 	}
-	result = dp_hi->init();
+	result = (reread || !pots[1]->initialized()) ? pots[1]->init() : 0;
 	if (result != 0) {
 		printf("Failed to init() dp_hi (0x%02x) with cause (%d).", i2c_addr_dp_hi, result);
 		return AUDIO_ROUTER_ERROR_BUS;
 	}
-	result = cp_switch->init();
+	result = (reread || !cp_switch->initialized()) ? cp_switch->init() : 0;
 	if (result != 0) {
 		printf("Failed to init() cp_switch (0x%02x) with cause (%d).", i2c_addr_cp_switch, result);
 		return AUDIO_ROUTER_ERROR_BUS;
@@ -108,41 +140,74 @@ int8_t AudioRouter::init(void) {
 	// If we are this far, it means we've successfully refreshed all the device classes
 	//   to reflect the state of the hardware. Now to parse that data into structs that
 	//   mean something to us at this level...
+	load_chips();
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* Re-read the switch and both pots, and take what they report as the truth. For when
+*   writes may have been lost between us and the chips. Whatever could be read is
+*   published, even if some of it couldn't.
+*/
+int8_t AudioRouter::refresh(void) {
+	int8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
+	if (pots[0]->refresh() != 0)   return_value = AUDIO_ROUTER_ERROR_BUS;
+	if (pots[1]->refresh() != 0)   return_value = AUDIO_ROUTER_ERROR_BUS;
+	if (cp_switch->refresh() != 0) return_value = AUDIO_ROUTER_ERROR_BUS;
+	load_chips();
+	publish();
+	return return_value;
+}
+
+
+void AudioRouter::deferLatch(bool x) {
+	cp_switch->deferLatch(x);
+}
+
+
+/*
+* commit() published the batch as though the latch had landed. If it didn't, the
+*   switch was read back, and what we publish now says so.
+*/
+int8_t AudioRouter::settle(void) {
+	if (cp_switch->settle() == 0) return AUDIO_ROUTER_ERROR_NO_ERROR;
+	load_chips();
+	publish();
+	return AUDIO_ROUTER_ERROR_BUS;
+}
+
+
+/*
+* Rebuild the outputs from the chip classes' idea of the hardware.
+*/
+void AudioRouter::load_chips(void) {
 	for (int i = 0; i < 8; i++) {  // Volumes...
-		outputs[i]->dp_val = outputs[i]->dp_dev->getValue(outputs[i]->dp_reg);
+		outputs[i].dp_val = pots[outputs[i].dp_chip]->getValue(outputs[i].dp_reg);
 	}
 	
+	for (int i = 0; i < 8; i++) bind(i, AUDIO_ROUTER_UNBOUND);
 	for (int i = 0; i < 12; i++) {  // Routes...
-		uint8_t temp_byte = cp_switch->getValue(inputs[i]->cp_row);
+		uint8_t temp_byte = cp_switch->getValue(inputs[i].cp_row);
 		for (int j = 0; j < 8; j++) {
 			if (0x01 & temp_byte) {
-				CPOutputChannel* temp_output = getOutputByCol(j);
-				if (temp_output != NULL) {
-					temp_output->cp_row = inputs[i];
-				}
+				bind(col_unmap[j], i);
 			}
 			temp_byte = temp_byte >> 1;
 		}
 	}
-	
-	return AUDIO_ROUTER_ERROR_NO_ERROR;
 }
 
 
 CPOutputChannel* AudioRouter::getOutputByCol(uint8_t col) {
 	if (col > 7)  return NULL;
-	for (int j = 0; j < 8; j++) {
-		if (outputs[j]->cp_column == col) {
-			return outputs[j];
-		}
-	}
-	return NULL;
+	return &outputs[col_unmap[col]];
 }
 
 
 void AudioRouter::preserveOnDestroy(bool x) {
-	if (dp_lo != NULL) dp_lo->preserveOnDestroy(x);
-	if (dp_hi != NULL) dp_hi->preserveOnDestroy(x);
+	if (pots[0] != NULL) pots[0]->preserveOnDestroy(x);
+	if (pots[1] != NULL) pots[1]->preserveOnDestroy(x);
 	if (cp_switch != NULL) cp_switch->preserveOnDestroy(x);
 }
 
@@ -154,7 +219,8 @@ void AudioRouter::preserveOnDestroy(bool x) {
 */
 int8_t AudioRouter::nameInput(uint8_t row, const char* name) {
 	if (row > 11) return AUDIO_ROUTER_ERROR_BAD_ROW;
-	inputs[row]->name = (char *) name;
+	inputs[row].name = (char *) name;
+	publish();
 	return AUDIO_ROUTER_ERROR_NO_ERROR;
 }
 
@@ -166,7 +232,8 @@ int8_t AudioRouter::nameInput(uint8_t row, const char* name) {
 */
 int8_t AudioRouter::nameOutput(uint8_t col, const char* name) {
 	if (col > 7) return AUDIO_ROUTER_ERROR_BAD_COLUMN;
-	outputs[col]->name = (char *) name;
+	outputs[col].name = (char *) name;
+	publish();
 	return AUDIO_ROUTER_ERROR_NO_ERROR;
 }
 
@@ -175,28 +242,101 @@ int8_t AudioRouter::nameOutput(uint8_t col, const char* name) {
 int8_t AudioRouter::unroute(uint8_t col, uint8_t row) {
 	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
 	if (row > 11) return AUDIO_ROUTER_ERROR_BAD_ROW;
-	bool remove_link = (outputs[col]->cp_row == inputs[row]) ? true : false;
+	if (batch_open) {
+		if (staged_row[col] == row) staged_row[col] = AUDIO_ROUTER_UNBOUND;
+		return AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+	bool remove_link = (outputs[col].cp_row == row) ? true : false;
 	uint8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
-	if (cp_switch->unsetRoute(outputs[col]->cp_column, row) < 0) {
+	if (cp_switch->unsetRoute(outputs[col].cp_column, row) < 0) {
 		return AUDIO_ROUTER_ERROR_UNROUTE_FAILED;
 	}
-	if (remove_link) outputs[col]->cp_row = NULL;
+	if (remove_link) bind(col, AUDIO_ROUTER_UNBOUND);
+	publish();
 	return return_value;
 }
 
 
+/*
+* Outside of a batch, this is a batch of one. So only the switches that are actually
+*   closed get written.
+*/
 int8_t AudioRouter::unroute(uint8_t col) {
 	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
-	uint8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
-	for (int i = 0; i < 12; i++) {
-		if (unroute(col, i) != AUDIO_ROUTER_ERROR_NO_ERROR) {
-			return AUDIO_ROUTER_ERROR_UNROUTE_FAILED;
+	if (batch_open) {
+		staged_row[col] = AUDIO_ROUTER_UNBOUND;
+		return AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+	begin();
+	staged_row[col] = AUDIO_ROUTER_UNBOUND;
+	return (commit() == AUDIO_ROUTER_ERROR_NO_ERROR) ? AUDIO_ROUTER_ERROR_NO_ERROR : AUDIO_ROUTER_ERROR_UNROUTE_FAILED;
+}
+
+
+/*
+* Route one input to every output in the mask, latched together.
+*/
+int8_t AudioRouter::routeMany(uint8_t row, uint8_t mask) {
+	if (row > 11) return AUDIO_ROUTER_ERROR_BAD_ROW;
+	bool own_batch = !batch_open;
+	if (own_batch) begin();
+	int8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < 8; i++) {
+		if ((mask & (1 << i)) && (route(i, row) == AUDIO_ROUTER_ERROR_INPUT_DISPLACED)) {
+			return_value = AUDIO_ROUTER_ERROR_INPUT_DISPLACED;
 		}
 	}
+	if (own_batch) {
+		int8_t result = commit();
+		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
 	return return_value;
 }
 
 
+/*
+* Disconnect the given input from every output it feeds.
+*/
+int8_t AudioRouter::unrouteInput(uint8_t row) {
+	if (row > 11) return AUDIO_ROUTER_ERROR_BAD_ROW;
+	bool own_batch = !batch_open;
+	if (own_batch) begin();
+	for (uint8_t i = 0; i < 8; i++) {
+		if (staged_row[i] == row) staged_row[i] = AUDIO_ROUTER_UNBOUND;
+	}
+	if (own_batch && (commit() != AUDIO_ROUTER_ERROR_NO_ERROR)) {
+		return AUDIO_ROUTER_ERROR_UNROUTE_FAILED;
+	}
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+uint8_t AudioRouter::getFanout(uint8_t row) {
+	return (row > 11) ? 0 : fanout[row];
+}
+
+
+uint8_t AudioRouter::getRoute(uint8_t col) {
+	return (col > 7) ? AUDIO_ROUTER_UNBOUND : outputs[col].cp_row;
+}
+
+
+uint8_t AudioRouter::getVolume(uint8_t col) {
+	return (col > 7) ? 0 : outputs[col].dp_val;
+}
+
+
+/*
+* All changes to what an output is bound to go through here, so that the per-input
+*   fan-out masks always agree with the outputs.
+*/
+void AudioRouter::bind(uint8_t col, uint8_t row) {
+	if (outputs[col].cp_row < 12) fanout[outputs[col].cp_row] &= ~(1 << col);
+	outputs[col].cp_row = row;
+	if (row < 12) fanout[row] |= (1 << col);
+}
+
+
 /*
 * Remember: This is the class responsible for ensuring that we don't cross-wire a circuit.
 *   The crosspoint switch class is generalized, and knows nothing about the circuit it is
@@ -204,69 +344,532 @@ int8_t AudioRouter::unroute(uint8_t col) {
 *   to route two inputs to the same output, it will oblige and possibly fry hastily-built
 *   hardware. So under that condition, we unroute prior to routing and return a code to
 *   indicate that we've done so.
+* Outside of a batch, this is a batch of one. So displacing an input costs only the
+*   switch that opens and the one that closes, latched together.
 */
 int8_t AudioRouter::route(uint8_t col, uint8_t row) {
-	uint8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
 	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
 	if (row > 11) return AUDIO_ROUTER_ERROR_BAD_ROW;
-	
-	if (outputs[col]->cp_row != NULL) {
-		int8_t result = unroute(col);
-		if (result == AUDIO_ROUTER_ERROR_NO_ERROR) {
-			return_value = AUDIO_ROUTER_ERROR_INPUT_DISPLACED;
-			outputs[col]->cp_row = NULL;
-		}
-		else {
-			return_value = AUDIO_ROUTER_ERROR_UNROUTE_FAILED;
-		}
+
+	if (batch_open) {
+		int8_t return_value = ((staged_row[col] != AUDIO_ROUTER_UNBOUND) && (staged_row[col] != row)) ? AUDIO_ROUTER_ERROR_INPUT_DISPLACED : AUDIO_ROUTER_ERROR_NO_ERROR;
+		staged_row[col] = row;
+		return return_value;
 	}
-	
-	if (return_value >= 0) {
-		int8_t result = cp_switch->setRoute(outputs[col]->cp_column, row);
-		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) {
-			return_value = result;
-		}
-		else {
-			outputs[col]->cp_row = inputs[row];
-		}
+
+	int8_t return_value = ((outputs[col].cp_row != AUDIO_ROUTER_UNBOUND) && (outputs[col].cp_row != row)) ? AUDIO_ROUTER_ERROR_INPUT_DISPLACED : AUDIO_ROUTER_ERROR_NO_ERROR;
+	begin();
+	staged_row[col] = row;
+	int8_t result = commit();
+	return (result == AUDIO_ROUTER_ERROR_NO_ERROR) ? return_value : result;
+}
+
+
+int8_t AudioRouter::begin(void) {
+	if (batch_open) return AUDIO_ROUTER_ERROR_IN_BATCH;
+	for (int i = 0; i < 8; i++) {
+		staged_row[i] = outputs[i].cp_row;
 	}
-	
-	return return_value;
+	staged_vol_mask = 0;
+	batch_open = true;
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+int8_t AudioRouter::abort(void) {
+	if (!batch_open) return AUDIO_ROUTER_ERROR_NO_BATCH;
+	batch_open = false;
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+bool AudioRouter::inBatch(void) {
+	return batch_open;
+}
+
+
+/*
+* Readers see the batch all at once, whether or not all of it made it to the bus.
+*/
+int8_t AudioRouter::commit(void) {
+	if (!batch_open) return AUDIO_ROUTER_ERROR_NO_BATCH;
+	batch_open = false;
+	int8_t result = apply_batch();
+	publish();
+	return result;
+}
+
+
+/*
+* The batch only holds one row per output, so the matrix it builds can't close two
+*   rows onto a column. If the switches fail to move, the levels go back to where they
+*   were before the batch, rather than being left ducked.
+*/
+int8_t AudioRouter::apply_batch(void) {
+
+	uint8_t matrix[12];
+	memset(matrix, 0x00, sizeof(matrix));
+	for (int i = 0; i < 8; i++) {
+		if (staged_row[i] < 12) matrix[staged_row[i]] |= (0x01 << outputs[i].cp_column);
+	}
+
+	uint8_t before[8];
+	uint8_t vol[8];
+	for (int i = 0; i < 8; i++) {
+		if (staged_vol_mask & (1 << i)) ramps[i].active = false;
+		uint8_t target = (staged_vol_mask & (1 << i)) ? staged_vol[i] : outputs[i].dp_val;
+		before[i] = outputs[i].dp_val;
+		vol[i] = (target < outputs[i].dp_val) ? target : outputs[i].dp_val;
+	}
+	int8_t result = write_levels(vol);     // Going down...
+	if (result == AUDIO_ROUTER_ERROR_NO_ERROR) {
+		result = cp_switch->setMatrix(matrix);
+	}
+	if (result != AUDIO_ROUTER_ERROR_NO_ERROR) {
+		write_levels(before);
+		return result;
+	}
+	for (int i = 0; i < 8; i++) {
+		bind(i, staged_row[i]);
+	}
+
+	for (int i = 0; i < 8; i++) {
+		if (staged_vol_mask & (1 << i)) vol[i] = staged_vol[i];
+	}
+	return write_levels(vol);              // ...and going up.
 }
 
 
 int8_t AudioRouter::setVolume(uint8_t col, uint8_t vol) {
 	int8_t return_value = AUDIO_ROUTER_ERROR_NO_ERROR;
 	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
-	return_value = outputs[col]->dp_dev->setValue(outputs[col]->dp_reg, vol);
+	if (batch_open) {
+		staged_vol[col] = vol;
+		staged_vol_mask |= (1 << col);
+		return AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+	ramps[col].active = false;
+	return_value = pots[outputs[col].dp_chip]->setValue(outputs[col].dp_reg, vol);
+	if (return_value == AUDIO_ROUTER_ERROR_NO_ERROR) outputs[col].dp_val = vol;
+	publish();
 	return return_value;
 }
 
 
+int8_t AudioRouter::setVolumeDb(uint8_t col, int16_t db10) {
+	return setVolume(col, volume_taper_db10(db10));
+}
+
+
+int8_t AudioRouter::setVolumeNormalized(uint8_t col, uint8_t pos) {
+	return setVolume(col, taper_audio[pos]);
+}
+
+
+int16_t AudioRouter::getVolumeDb(uint8_t col) {
+	if (col > 7)  return VOLUME_TAPER_MUTE_DB10;
+	return taper_wiper_db[outputs[col].dp_val];
+}
+
+
+/*
+* Each pot chip serves four outputs, and takes all four of its wipers in one write.
+*   So rather than eight writes, this costs two.
+*/
+int8_t AudioRouter::setVolumes(const uint8_t vol[8]) {
+	if (batch_open) {
+		memcpy(staged_vol, vol, sizeof(staged_vol));
+		staged_vol_mask = 0xFF;
+		return AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+	for (int i = 0; i < 8; i++) ramps[i].active = false;
+	int8_t result = write_chip(0, vol);
+	if (result == AUDIO_ROUTER_ERROR_NO_ERROR) result = write_chip(1, vol);
+	publish();
+	return result;
+}
+
+
+/*
+* Write the volumes of every output served by the given chip in one burst. Wipers that
+*   don't belong to any output are left as they were.
+*/
+int8_t AudioRouter::write_chip(uint8_t chip, const uint8_t vol[8]) {
+	uint8_t wipers[4];
+	for (int i = 0; i < 4; i++) wipers[i] = pots[chip]->getValue(i);
+	for (int i = 0; i < 8; i++) {
+		if (outputs[i].dp_chip == chip) wipers[outputs[i].dp_reg] = vol[i];
+	}
+	int8_t result = pots[chip]->setValues(wipers);
+	if (result != AUDIO_ROUTER_ERROR_NO_ERROR) {
+		return result;
+	}
+	for (int i = 0; i < 8; i++) {
+		if (outputs[i].dp_chip == chip) outputs[i].dp_val = vol[i];
+	}
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* Start a ramp from wherever the output is now. If it was already ramping, the new
+*   ramp takes over from the present position, so retargeting mid-fade doesn't jump.
+*/
+int8_t AudioRouter::fadeTo(uint8_t col, uint8_t vol, uint32_t duration_ms, uint8_t curve) {
+	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (curve > AUDIO_ROUTER_CURVE_SCURVE) return AUDIO_ROUTER_ERROR_BAD_CURVE;
+	if (duration_ms == 0) return setVolume(col, vol);
+
+	ramps[col].t_start  = millis();
+	ramps[col].duration = duration_ms;
+	ramps[col].start    = outputs[col].dp_val;
+	ramps[col].target   = vol;
+	ramps[col].curve    = curve;
+	ramps[col].active   = (vol != outputs[col].dp_val);
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+int8_t AudioRouter::stopFade(uint8_t col) {
+	if (col > 7)  return AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	ramps[col].active = false;
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+bool AudioRouter::fading(uint8_t col) {
+	return ((col < 8) && ramps[col].active);
+}
+
+
+bool AudioRouter::fading(void) {
+	for (int i = 0; i < 8; i++) {
+		if (ramps[i].active) return true;
+	}
+	return false;
+}
+
+
+void AudioRouter::setRampPeriod(uint16_t ms) {
+	ramp_period = ms;
+}
+
+
+/*
+* Where a ramp should be, given how far into it we are. Progress is carried as a
+*   16-bit binary fraction.
+*/
+uint8_t AudioRouter::ramp_value(CPRamp* ramp, uint32_t elapsed) {
+	uint32_t p = (uint32_t) (((uint64_t) elapsed << 16) / ramp->duration);
+	int32_t  span = (int32_t) ramp->target - (int32_t) ramp->start;
+	switch (ramp->curve) {
+		case AUDIO_ROUTER_CURVE_SCURVE:
+			// Smoothstep: 3p^2 - 2p^3
+			p = (uint32_t) (((((uint64_t) p * p) >> 16) * (196608 - (2 * (uint64_t) p))) >> 16);
+			break;
+		case AUDIO_ROUTER_CURVE_LOG:
+			{
+				// Interpolate in dB, with silence treated as the bottom of the table.
+				int32_t db_start  = (ramp->start  == 0) ? VOLUME_TAPER_FLOOR_DB10 : taper_wiper_db[ramp->start];
+				int32_t db_target = (ramp->target == 0) ? VOLUME_TAPER_FLOOR_DB10 : taper_wiper_db[ramp->target];
+				return volume_taper_db10((int16_t) (db_start + (((db_target - db_start) * (int32_t) p) / 65536)));
+			}
+		default:
+			break;
+	}
+	return (uint8_t) (ramp->start + ((span * (int32_t) p) / 65536));
+}
+
+
+int8_t AudioRouter::tick(void) {
+	return tick(millis());
+}
+
+
+/*
+* Advance every active ramp, and write whatever moved. Outputs sharing a pot chip go
+*   out together, so this costs at most one write per chip. Pots in write-back mode
+*   get their chance to flush here as well.
+*/
+int8_t AudioRouter::tick(uint32_t now_ms) {
+	int8_t result = AUDIO_ROUTER_ERROR_NO_ERROR;
+	if ((uint32_t) (now_ms - last_tick) >= ramp_period) {
+		last_tick = now_ms;
+		result = step_ramps(now_ms);
+	}
+	if (result == AUDIO_ROUTER_ERROR_NO_ERROR) result = pots[0]->poll();
+	if (result == AUDIO_ROUTER_ERROR_NO_ERROR) result = pots[1]->poll();
+	publish();
+	return result;
+}
+
+
+int8_t AudioRouter::step_ramps(uint32_t now_ms) {
+	uint8_t vol[8];
+	for (int i = 0; i < 8; i++) {
+		vol[i] = outputs[i].dp_val;
+		if (ramps[i].active) {
+			uint32_t elapsed = now_ms - ramps[i].t_start;
+			if (elapsed >= ramps[i].duration) {
+				vol[i] = ramps[i].target;
+				ramps[i].active = false;
+			}
+			else {
+				vol[i] = ramp_value(&ramps[i], elapsed);
+			}
+		}
+	}
+	return write_levels(vol);
+}
+
+
+/*
+* Write the given output levels, touching only the pot chips that have a change.
+*/
+int8_t AudioRouter::write_levels(const uint8_t vol[8]) {
+	bool dirty[2] = {false, false};
+	for (int i = 0; i < 8; i++) {
+		if (vol[i] != outputs[i].dp_val) dirty[outputs[i].dp_chip] = true;
+	}
+	int8_t result = AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t c = 0; (c < 2) && (result == AUDIO_ROUTER_ERROR_NO_ERROR); c++) {
+		if (dirty[c]) result = write_chip(c, vol);
+	}
+	return result;
+}
+
+
+
+/*
+* Put both pot chips into (or out of) write-back mode. See ISL23345::setWriteBack().
+*/
+void AudioRouter::setWriteBack(bool enable, uint16_t flush_ms) {
+	pots[0]->setWriteBack(enable, flush_ms);
+	pots[1]->setWriteBack(enable, flush_ms);
+}
+
+
+int8_t AudioRouter::flush(void) {
+	int8_t result = pots[0]->flush();
+	if (result != AUDIO_ROUTER_ERROR_NO_ERROR) {
+		return result;
+	}
+	return pots[1]->flush();
+}
+
+
+/*
+* Capture the live state into a scene slot, replacing whatever was there.
+*/
+int8_t AudioRouter::saveScene(uint8_t slot, const char* name) {
+	if (slot >= AUDIO_ROUTER_MAX_SCENES) return AUDIO_ROUTER_ERROR_BAD_SCENE;
+	capture(&scenes[slot], name);
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+void AudioRouter::capture(CPScene* sc, const char* name) {
+	memset(sc->name, 0x00, sizeof(sc->name));
+	if (name != NULL) strncpy(sc->name, name, sizeof(sc->name) - 1);
+	for (int i = 0; i < 8; i++) {
+		sc->row[i]       = outputs[i].cp_row;
+		sc->vol[i]       = outputs[i].dp_val;
+		sc->out_names[i] = outputs[i].name;
+	}
+	for (int i = 0; i < 12; i++) {
+		sc->in_names[i] = inputs[i].name;
+	}
+	sc->enabled    = live_enabled();
+	sc->used       = true;
+	sc->plan.valid = false;
+}
+
+
+/*
+* Fill a scene slot from somewhere other than the live state (a preset library, for
+*   instance). Channel names aren't part of that, so the scene keeps the live ones.
+*/
+int8_t AudioRouter::setScene(uint8_t slot, const char* name, const uint8_t row[8], const uint8_t vol[8], bool enabled) {
+	if (slot >= AUDIO_ROUTER_MAX_SCENES) return AUDIO_ROUTER_ERROR_BAD_SCENE;
+	for (int i = 0; i < 8; i++) {
+		if ((row[i] != AUDIO_ROUTER_UNBOUND) && (row[i] > 11)) return AUDIO_ROUTER_ERROR_BAD_ROW;
+	}
+	CPScene* sc = &scenes[slot];
+	capture(sc, name);
+	memcpy(sc->row, row, sizeof(sc->row));
+	memcpy(sc->vol, vol, sizeof(sc->vol));
+	sc->enabled = enabled;
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* If the cached plan was made from the state we are in now, it is used as-is.
+*   Otherwise it is compiled again from here.
+*/
+int8_t AudioRouter::recallScene(uint8_t slot) {
+	if ((slot >= AUDIO_ROUTER_MAX_SCENES) || !scenes[slot].used) return AUDIO_ROUTER_ERROR_BAD_SCENE;
+	if (batch_open) return AUDIO_ROUTER_ERROR_IN_BATCH;
+	return recall(&scenes[slot]);
+}
+
+
+/*
+* Go to the given state the way a scene recall would, without using a scene slot.
+*   The plan is made in a scratch scene, so it is compiled every time. Channel names
+*   are left as they are.
+*/
+int8_t AudioRouter::applyState(const uint8_t row[8], const uint8_t vol[8], bool enabled) {
+	for (int i = 0; i < 8; i++) {
+		if ((row[i] != AUDIO_ROUTER_UNBOUND) && (row[i] > 11)) return AUDIO_ROUTER_ERROR_BAD_ROW;
+	}
+	if (batch_open) return AUDIO_ROUTER_ERROR_IN_BATCH;
+	CPScene scratch;
+	capture(&scratch, NULL);
+	memcpy(scratch.row, row, sizeof(scratch.row));
+	memcpy(scratch.vol, vol, sizeof(scratch.vol));
+	scratch.enabled = enabled;
+	return recall(&scratch);
+}
+
+
+int8_t AudioRouter::recall(CPScene* sc) {
+	CPScenePlan* p = &sc->plan;
+
+	bool stale = !p->valid || (p->from_enabled != live_enabled());
+	for (int i = 0; (i < 8) && !stale; i++) {
+		stale = (p->from_row[i] != outputs[i].cp_row) || (p->from_vol[i] != outputs[i].dp_val);
+	}
+	if (stale) compile_scene(sc);
+
+	for (int i = 0; i < 8; i++) ramps[i].active = false;
+	int8_t result = run_plan(sc);
+	if (result >= 0) {
+		// The names describe the scene's wiring. If we didn't get there, they'd be lies.
+		for (int i = 0; i < 8; i++)  outputs[i].name = sc->out_names[i];
+		for (int i = 0; i < 12; i++) inputs[i].name  = sc->in_names[i];
+	}
+	publish();
+	return result;
+}
+
+
+int8_t AudioRouter::clearScene(uint8_t slot) {
+	if (slot >= AUDIO_ROUTER_MAX_SCENES) return AUDIO_ROUTER_ERROR_BAD_SCENE;
+	scenes[slot].used       = false;
+	scenes[slot].plan.valid = false;
+	return AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+int8_t AudioRouter::findScene(const char* name) {
+	if (name == NULL) return AUDIO_ROUTER_ERROR_BAD_SCENE;
+	for (uint8_t i = 0; i < AUDIO_ROUTER_MAX_SCENES; i++) {
+		if (scenes[i].used && (0 == strncmp(scenes[i].name, name, sizeof(scenes[i].name)))) return i;
+	}
+	return AUDIO_ROUTER_ERROR_BAD_SCENE;
+}
+
+
+const CPScene* AudioRouter::getScene(uint8_t slot) {
+	if ((slot >= AUDIO_ROUTER_MAX_SCENES) || !scenes[slot].used) return NULL;
+	return &scenes[slot];
+}
+
+
+bool AudioRouter::live_enabled(void) {
+	return (pots[0]->enabled() && pots[1]->enabled());
+}
+
+
+/*
+* Work out how to get from the live state to the scene. An output whose route is
+*   changing is silenced for the switch change. Others only come down if the scene
+*   has them quieter. Steps with nothing to do are left out of the plan.
+*/
+void AudioRouter::compile_scene(CPScene* sc) {
+	CPScenePlan* p = &sc->plan;
+	p->steps        = 0;
+	p->from_enabled = live_enabled();
+	memset(p->matrix, 0x00, sizeof(p->matrix));
+	for (int i = 0; i < 8; i++) {
+		p->from_row[i] = outputs[i].cp_row;
+		p->from_vol[i] = outputs[i].dp_val;
+		p->restore[i]  = sc->vol[i];
+		if (sc->row[i] < 12) p->matrix[sc->row[i]] |= (0x01 << outputs[i].cp_column);
+		if (sc->row[i] != outputs[i].cp_row) {
+			p->steps |= AUDIO_ROUTER_PLAN_SWITCH;
+			p->duck[i] = 0;
+		}
+		else {
+			p->duck[i] = (sc->vol[i] < outputs[i].dp_val) ? sc->vol[i] : outputs[i].dp_val;
+		}
+		if (p->duck[i] != outputs[i].dp_val) p->steps |= AUDIO_ROUTER_PLAN_DUCK;
+		if (p->restore[i] != p->duck[i])     p->steps |= AUDIO_ROUTER_PLAN_RESTORE;
+	}
+	if (sc->enabled && !p->from_enabled) p->steps |= AUDIO_ROUTER_PLAN_ENABLE;
+	if (!sc->enabled && p->from_enabled) p->steps |= AUDIO_ROUTER_PLAN_DISABLE;
+	p->valid = true;
+}
+
+
+/*
+* Disabling a scene only shuts the pots down. The switch is left as the scene has it,
+*   so that enable() brings the scene back.
+*/
+int8_t AudioRouter::run_plan(CPScene* sc) {
+	CPScenePlan* p = &sc->plan;
+	int8_t result = AUDIO_ROUTER_ERROR_NO_ERROR;
+	if (p->steps & AUDIO_ROUTER_PLAN_DUCK) {
+		result = write_levels(p->duck);
+		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
+	if (p->steps & AUDIO_ROUTER_PLAN_SWITCH) {
+		result = cp_switch->setMatrix(p->matrix);
+		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+		for (int i = 0; i < 8; i++) bind(i, sc->row[i]);
+	}
+	if (p->steps & AUDIO_ROUTER_PLAN_ENABLE) {
+		result = enable();
+		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
+	if (p->steps & AUDIO_ROUTER_PLAN_RESTORE) {
+		result = write_levels(p->restore);
+		if (result != AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
+	if (p->steps & AUDIO_ROUTER_PLAN_DISABLE) {
+		result = pots[0]->disable();
+		if (result == AUDIO_ROUTER_ERROR_NO_ERROR) result = pots[1]->disable();
+	}
+	return result;
+}
+
 
 // Turn on the chips responsible for routing signals.
 int8_t AudioRouter::enable(void) {
-	int8_t result = dp_lo->enable();
+	int8_t result = pots[0]->enable();
 	if (result != 0) {
 		printf("enable() failed to enable dp_lo. Cause: (%d).\n", result);
 		return result;
 	}
-	result = dp_hi->enable();
+	result = pots[1]->enable();
 	if (result != 0) {
 		printf("enable() failed to enable dp_hi. Cause: (%d).\n", result);
 		return result;
 	}
+	publish();
 	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
 }
 
 // Turn off the chips responsible for routing signals.
 int8_t AudioRouter::disable(void) {
-	int8_t result = dp_lo->disable();
+	int8_t result = pots[0]->disable();
 	if (result != 0) {
 		printf("disable() failed to disable dp_lo. Cause: (%d).\n", result);
 		return result;
 	}
-	result = dp_hi->disable();
+	publish();   // The router counts as disabled as soon as either pot is.
+	result = pots[1]->disable();
 	if (result != 0) {
 		printf("disable() failed to disable dp_hi. Cause: (%d).\n", result);
 		return result;
@@ -276,6 +879,10 @@ int8_t AudioRouter::disable(void) {
 		printf("disable() failed to reset cp_switch. Cause: (%d).\n", result);
 		return result;
 	}
+	// The switch is open. Leaving the outputs bound would have the next batch (which
+	//   rebuilds the whole matrix) close every old route again.
+	for (int i = 0; i < 8; i++) bind(i, AUDIO_ROUTER_UNBOUND);
+	publish();   // Every output that was routed gets its unroute record here.
 	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
 }
 
@@ -287,23 +894,29 @@ void AudioRouter::dumpOutputChannel(uint8_t chan) {
 	}
 	printf("Output channel %d\n", chan);
 	
-	if (outputs[chan]->name != NULL) printf("%s\n", outputs[chan]->name);
-	printf("Switch column %d\n", outputs[chan]->cp_column);
-	if (outputs[chan]->dp_dev == NULL) {
+	if (outputs[chan].name != NULL) printf("%s\n", outputs[chan].name);
+	printf("Switch column %d\n", outputs[chan].cp_column);
+	if (pots[outputs[chan].dp_chip] == NULL) {
 		printf("Potentiometer is NULL\n");
 	}
 	else {
-		uint8_t temp_int = (outputs[chan]->dp_dev == dp_lo) ? 0 : 1;
-		printf("Potentiometer:            %d\n", temp_int);
-		printf("Potentiometer register:   %d\n", outputs[chan]->dp_reg);
-		printf("Potentiometer value:      %d\n", outputs[chan]->dp_val);
+		printf("Potentiometer:            %d\n", outputs[chan].dp_chip);
+		printf("Potentiometer register:   %d\n", outputs[chan].dp_reg);
+		printf("Potentiometer value:      %d\n", outputs[chan].dp_val);
+		int16_t db10 = getVolumeDb(chan);
+		if (db10 == VOLUME_TAPER_MUTE_DB10) {
+			printf("Level:                    muted\n");
+		}
+		else {
+			printf("Level:                    %s%d.%d dB\n", ((db10 < 0) ? "-" : ""), abs(db10) / 10, abs(db10) % 10);
+		}
 	}
-	if (outputs[chan]->cp_row == NULL) {
+	if (outputs[chan].cp_row == AUDIO_ROUTER_UNBOUND) {
 		printf("Output channel %d is presently unbound.\n", chan);
 	}
 	else {
 		printf("Output channel %d is presently bound to the following input...\n", chan);
-		dumpInputChannel(outputs[chan]->cp_row);
+		dumpInputChannel(&inputs[outputs[chan].cp_row]);
 	}
 }
 
@@ -324,22 +937,188 @@ void AudioRouter::dumpInputChannel(uint8_t chan) {
 		return;
 	}
 	printf("Input channel %d\n", chan);
-	if (inputs[chan]->name != NULL) printf("%s\n", inputs[chan]->name);
-	printf("Switch row: %d\n", inputs[chan]->cp_row);
+	if (inputs[chan].name != NULL) printf("%s\n", inputs[chan].name);
+	printf("Switch row: %d\n", inputs[chan].cp_row);
+	if (fanout[chan]) {
+		printf("Feeding outputs:");
+		for (int i = 0; i < 8; i++) {
+			if (fanout[chan] & (1 << i)) printf(" %d", i);
+		}
+		printf("\n");
+	}
 }
 
 
-// Write some status about the routes to the provided char buffer.
-int8_t AudioRouter::status(char* output) {
+/*
+* Build the snapshot of the state we are in now, and publish it if a reader could tell
+*   it apart from the last one. So this can be called after anything that might have
+*   changed the state, and costs readers nothing if it didn't.
+* The slot is marked odd while it is written. A reader that catches it that way, or
+*   finds the mark moved under it, goes around again.
+*/
+void AudioRouter::publish(void) {
+	CPSnapshot next;
+	memset(&next, 0x00, sizeof(next));
+	memcpy(next.fanout, fanout, sizeof(next.fanout));
 	for (int i = 0; i < 8; i++) {
-		dumpOutputChannel(i);
+		next.row[i] = outputs[i].cp_row;
+		next.vol[i] = outputs[i].dp_val;
+		if (outputs[i].name != NULL) strncpy(next.out_names[i], outputs[i].name, AUDIO_ROUTER_SNAPSHOT_NAME_LEN - 1);
 	}
-	printf("\n");
-	
-	dp_lo->dumpToLog();
-	dp_hi->dumpToLog();
-	cp_switch->dumpToLog();
-	
-	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (int i = 0; i < 12; i++) {
+		if (inputs[i].name != NULL) strncpy(next.in_names[i], inputs[i].name, AUDIO_ROUTER_SNAPSHOT_NAME_LEN - 1);
+	}
+	next.enabled = live_enabled();
+	next.health  = (cp_switch->initialized() ? AUDIO_ROUTER_HEALTH_SWITCH : 0) |
+		(pots[0]->initialized() ? AUDIO_ROUTER_HEALTH_POT_LO : 0) |
+		(pots[1]->initialized() ? AUDIO_ROUTER_HEALTH_POT_HI : 0);
+
+	CPSnapshot* last = &snaps[snap_gen % AUDIO_ROUTER_SNAPSHOTS].snap;
+	next.generation = last->generation;
+	if (0 == memcmp(&next, last, sizeof(next))) return;
+
+	// The records go out before the snapshot, so anyone who can see the generation can
+	//   also see what changed in it. The first snapshot is only a starting point.
+	next.generation = snap_gen + 1;
+	if (snap_gen > 0) {
+		for (uint8_t i = 0; i < 8; i++) {
+			if (next.row[i] != last->row[i]) {
+				if (next.row[i] == AUDIO_ROUTER_UNBOUND) record(next.generation, AUDIO_ROUTER_CHANGE_UNROUTE, i, last->row[i]);
+				else                                     record(next.generation, AUDIO_ROUTER_CHANGE_ROUTE, i, next.row[i]);
+			}
+			if (next.vol[i] != last->vol[i]) record(next.generation, AUDIO_ROUTER_CHANGE_LEVEL, i, next.vol[i]);
+		}
+		if (next.enabled != last->enabled) {
+			record(next.generation, (next.enabled ? AUDIO_ROUTER_CHANGE_ENABLE : AUDIO_ROUTER_CHANGE_DISABLE), AUDIO_ROUTER_UNBOUND, 0);
+		}
+	}
+
+	CPSnapshotSlot* slot = &snaps[next.generation % AUDIO_ROUTER_SNAPSHOTS];
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&slot->snap, &next, sizeof(next));
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&snap_gen, next.generation, __ATOMIC_RELEASE);
+}
+
+
+void AudioRouter::snapshot(CPSnapshot* snap) {
+	for (;;) {
+		CPSnapshotSlot* slot = &snaps[__atomic_load_n(&snap_gen, __ATOMIC_ACQUIRE) % AUDIO_ROUTER_SNAPSHOTS];
+		uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+		memcpy(snap, &slot->snap, sizeof(CPSnapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (seq == __atomic_load_n(&slot->seq, __ATOMIC_RELAXED)) return;
+	}
+}
+
+
+uint32_t AudioRouter::generation(void) {
+	return __atomic_load_n(&snap_gen, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+* When the ring is full, the oldest record is given up before its slot is reused.
+*   Readers check the tail after copying, so they never keep a record that was
+*   overwritten under them.
+*/
+void AudioRouter::record(uint32_t gen, uint8_t kind, uint8_t chan, uint8_t value) {
+	CPChange* rec = &changes[change_head % AUDIO_ROUTER_CHANGE_RING];
+	if ((change_head - change_tail) >= AUDIO_ROUTER_CHANGE_RING) {
+		__atomic_store_n(&evicted_gen, rec->generation, __ATOMIC_RELAXED);
+		__atomic_store_n(&change_tail, change_tail + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+	rec->generation = gen;
+	rec->kind       = kind;
+	rec->chan       = chan;
+	rec->value      = value;
+	rec->reserved   = 0;
+	__atomic_store_n(&change_head, change_head + 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Records are in generation order, so we walk back from the newest to find where the
+*   caller left off. The cost is in the number of changes, not the size of the router.
+*/
+int16_t AudioRouter::changesSince(uint32_t gen, CPChange* buf, uint16_t n) {
+	uint32_t head = __atomic_load_n(&change_head, __ATOMIC_ACQUIRE);
+	uint32_t tail = __atomic_load_n(&change_tail, __ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&evicted_gen, __ATOMIC_ACQUIRE) > gen) return AUDIO_ROUTER_ERROR_OVERRUN;
+
+	uint32_t first = head;
+	while ((first != tail) && (changes[(first - 1) % AUDIO_ROUTER_CHANGE_RING].generation > gen)) first--;
+
+	uint16_t count = 0;
+	for (uint32_t i = first; (i != head) && (count < n); i++) {
+		buf[count++] = changes[i % AUDIO_ROUTER_CHANGE_RING];
+	}
+	if ((first + count) != head) {
+		// Out of room. Give back the generation that didn't fit, unless it's all there is.
+		uint16_t whole = count;
+		while ((whole > 0) && (buf[whole - 1].generation == changes[(first + count) % AUDIO_ROUTER_CHANGE_RING].generation)) whole--;
+		if (whole > 0) count = whole;
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&change_tail, __ATOMIC_RELAXED) > first) return AUDIO_ROUTER_ERROR_OVERRUN;
+	return count;
+}
+
+
+/*
+* A snapshot as text. Used for our own status, and by anything else holding one (the
+*   shared state page, for instance). Stops short rather than overrunning.
+*/
+uint16_t AudioRouter::formatSnapshot(const CPSnapshot* snap, char* buf, uint16_t len) {
+	if ((buf == NULL) || (len == 0)) return 0;
+	int n = snprintf(buf, len, "Generation %u. The router is %s.\n", (unsigned) snap->generation, (snap->enabled ? "enabled" : "disabled"));
+	if ((snap->health & AUDIO_ROUTER_HEALTH_ALL) != AUDIO_ROUTER_HEALTH_ALL) {
+		if (n < len) n += snprintf(buf + n, len - n, "Not responding:%s%s%s\n",
+			((snap->health & AUDIO_ROUTER_HEALTH_SWITCH) ? "" : " switch"),
+			((snap->health & AUDIO_ROUTER_HEALTH_POT_LO) ? "" : " dp_lo"),
+			((snap->health & AUDIO_ROUTER_HEALTH_POT_HI) ? "" : " dp_hi"));
+	}
+	for (int i = 0; (i < 8) && (n < len); i++) {
+		n += snprintf(buf + n, len - n, "Output %d", i);
+		if (snap->out_names[i][0] && (n < len)) n += snprintf(buf + n, len - n, " (%s)", snap->out_names[i]);
+		int16_t db10 = taper_wiper_db[snap->vol[i]];
+		if (n >= len) break;
+		if (db10 == VOLUME_TAPER_MUTE_DB10) {
+			n += snprintf(buf + n, len - n, ": level %d (muted), ", snap->vol[i]);
+		}
+		else {
+			n += snprintf(buf + n, len - n, ": level %d (%s%d.%d dB), ", snap->vol[i], ((db10 < 0) ? "-" : ""), abs(db10) / 10, abs(db10) % 10);
+		}
+		if (n >= len) break;
+		uint8_t row = snap->row[i];
+		if (row == AUDIO_ROUTER_UNBOUND) {
+			n += snprintf(buf + n, len - n, "unbound.\n");
+		}
+		else if ((row < 12) && snap->in_names[row][0]) {
+			n += snprintf(buf + n, len - n, "fed by input %d (%s).\n", row, snap->in_names[row]);
+		}
+		else {
+			n += snprintf(buf + n, len - n, "fed by input %d.\n", row);
+		}
+	}
+	return (n < len) ? n : (len - 1);
 }
 
+
+/*
+* Served from the latest snapshot. Nothing here touches the bus.
+*/
+int8_t AudioRouter::status(char* output, uint16_t len) {
+	if ((output == NULL) || (len == 0)) return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	CPSnapshot snap;
+	snapshot(&snap);
+	int n = formatSnapshot(&snap, output, len);
+	for (int i = 0; (i < AUDIO_ROUTER_MAX_SCENES) && (n < len); i++) {
+		if (scenes[i].used) n += snprintf(output + n, len - n, "Scene %d: %s\n", i, scenes[i].name);
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
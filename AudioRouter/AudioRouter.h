@@ -28,6 +28,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "../ISL23345/ISL23345.h"
 #include "../ADG2128/ADG2128.h"
+#include "VolumeTaper.h"
 
 
 #include <inttypes.h>
@@ -64,37 +65,144 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 *   oddities between inputs on the switch and output channels (uint8_t pot_remap[8]).
 *
 * The digital potentiometers are linear across their range. Therefore, if you are going to use this class for audio,
-*   you should adjust volume in a logrithmic manner. Additionally, the pots do not have zero-crossing detection. So
-*   to avoid getting the "zipper" sound when changing volume, you should unroute() the channel prior to adjusting volume,
-*   then route it again after the volume is set.
+*   you should adjust volume in a logrithmic manner. setVolumeDb() and setVolumeNormalized() do that for you, by table
+*   (see VolumeTaper.h). Additionally, the pots do not have zero-crossing detection. So
+*   to avoid getting the "zipper" sound when changing volume, you should either unroute() the channel prior to adjusting
+*   volume (and route it again after the volume is set), or use fadeTo() and call tick() often.
 */
 
+#define AUDIO_ROUTER_RAMP_PERIOD_MS   5      // Default minimum interval between ramp steps.
+#define AUDIO_ROUTER_UNBOUND          0xFF   // The row of an output that isn't routed.
+
+#ifndef AUDIO_ROUTER_MAX_SCENES
+  #define AUDIO_ROUTER_MAX_SCENES     8      // How many scenes a router holds. Each costs a few hundred bytes.
+#endif
+#define AUDIO_ROUTER_SCENE_NAME_LEN   16     // Including the terminator.
+#define AUDIO_ROUTER_SNAPSHOT_NAME_LEN 16    // Channel names are cut to this in snapshots, terminator included.
+#define AUDIO_ROUTER_SNAPSHOTS        4      // Published snapshots kept at once. Must be a power of two.
+
+#ifndef AUDIO_ROUTER_CHANGE_RING
+  #define AUDIO_ROUTER_CHANGE_RING    64     // Change records kept. Must be a power of two. Each costs 8 bytes.
+#endif
+#define AUDIO_ROUTER_MAX_CHANGES_PER_GEN 17  // Every route and level, and the enable state.
+
+// The kinds of change record.
+#define AUDIO_ROUTER_CHANGE_ROUTE     0x01   // value is the input now feeding chan.
+#define AUDIO_ROUTER_CHANGE_UNROUTE   0x02   // chan is no longer fed. value is the input that was.
+#define AUDIO_ROUTER_CHANGE_LEVEL     0x03   // value is chan's new wiper value.
+#define AUDIO_ROUTER_CHANGE_ENABLE    0x04   // chan is AUDIO_ROUTER_UNBOUND.
+#define AUDIO_ROUTER_CHANGE_DISABLE   0x05   // chan is AUDIO_ROUTER_UNBOUND.
+
+// Health flags. A chip's flag is set once it has answered on the bus.
+#define AUDIO_ROUTER_HEALTH_SWITCH    0x01
+#define AUDIO_ROUTER_HEALTH_POT_LO    0x02
+#define AUDIO_ROUTER_HEALTH_POT_HI    0x04
+#define AUDIO_ROUTER_HEALTH_ALL       0x07
+
 
 // This struct defines an input pin on the PCB.
 typedef struct cps_input_channel_t {
-  uint8_t   cp_row;
   char*     name;                // A name for this input. Not required, but helpful for debug and output.
+  uint8_t   cp_row;
 } CPInputChannel;
 
 
 // This struct defines an output pin on the PCB.
 typedef struct cps_output_channel_t {
-  uint8_t         cp_column;
   char*           name;          // A name for this output. Not required, but helpful for debug and output.
-  ISL23345*       dp_dev;        // Instance of the ISL23345 that is attached to this pin.
+  uint8_t         cp_column;
+  uint8_t         cp_row;        // The row that is presently bound to this column. AUDIO_ROUTER_UNBOUND if none.
+  uint8_t         dp_chip;       // Which of the ISL23345s is attached to this pin (0 or 1).
   uint8_t         dp_reg;        // The ISL23345 register that services this pin.
   uint8_t         dp_val;        // The value of the variable resistor for this pin (0-255 linear).
-  CPInputChannel* cp_row;        // A pointer to the row that is presently bound to this column. If NULL, it is unbound.
 } CPOutputChannel;
 
 
+// This struct holds the state of a volume ramp on an output.
+typedef struct cps_ramp_t {
+  uint32_t        t_start;       // millis() when the ramp began.
+  uint32_t        duration;      // How long the ramp should take (ms).
+  uint8_t         start;         // The wiper value at the start of the ramp.
+  uint8_t         target;        // The wiper value at the end of the ramp.
+  uint8_t         curve;         // One of the AUDIO_ROUTER_CURVE_* values.
+  bool            active;
+} CPRamp;
+
+
+// The steps of a scene plan. Anything not set can be skipped.
+#define AUDIO_ROUTER_PLAN_DUCK        0x01
+#define AUDIO_ROUTER_PLAN_SWITCH      0x02
+#define AUDIO_ROUTER_PLAN_RESTORE     0x04
+#define AUDIO_ROUTER_PLAN_ENABLE      0x08
+#define AUDIO_ROUTER_PLAN_DISABLE     0x10
+
+// This struct is what it takes to get from one particular state to a scene.
+typedef struct cps_scene_plan_t {
+  uint8_t         from_row[8];   // The live state the plan was compiled against...
+  uint8_t         from_vol[8];
+  bool            from_enabled;
+  uint8_t         duck[8];       // ...the levels to hold while the switches move...
+  uint8_t         matrix[12];    // ...the switch state to latch...
+  uint8_t         restore[8];    // ...and the levels to finish on.
+  uint8_t         steps;         // Which of the AUDIO_ROUTER_PLAN_* steps are needed.
+  bool            valid;
+} CPScenePlan;
+
+
+// This struct holds a snapshot of the whole router.
+typedef struct cps_scene_t {
+  char            name[AUDIO_ROUTER_SCENE_NAME_LEN];
+  uint8_t         row[8];        // Per output. AUDIO_ROUTER_UNBOUND if unbound.
+  uint8_t         vol[8];
+  char*           in_names[12];
+  char*           out_names[8];
+  bool            enabled;
+  bool            used;
+  CPScenePlan     plan;          // Cached from the last recall.
+} CPScene;
+
+
+
+// This struct is the router's logical state, as published for readers on other threads.
+typedef struct cps_snapshot_t {
+  uint32_t        generation;    // Goes up by one with each state that differs from the last.
+  uint8_t         fanout[12];    // Per input, a mask of the outputs it feeds (bit n = output n).
+  uint8_t         row[8];        // Per output, the input feeding it. AUDIO_ROUTER_UNBOUND if none.
+  uint8_t         vol[8];
+  char            in_names[12][AUDIO_ROUTER_SNAPSHOT_NAME_LEN];
+  char            out_names[8][AUDIO_ROUTER_SNAPSHOT_NAME_LEN];
+  bool            enabled;
+  uint8_t         health;        // AUDIO_ROUTER_HEALTH_* flags.
+} CPSnapshot;
+
+
+// This struct is one entry in the change feed.
+typedef struct cps_change_t {
+  uint32_t        generation;    // The snapshot generation the change first appears in.
+  uint8_t         kind;          // One of the AUDIO_ROUTER_CHANGE_* values.
+  uint8_t         chan;          // The output. AUDIO_ROUTER_UNBOUND for the router as a whole.
+  uint8_t         value;
+  uint8_t         reserved;
+} CPChange;
+
+
+// A published snapshot, and the sequence number that guards it.
+typedef struct cps_snapshot_slot_t {
+  uint32_t        seq;           // Odd while the slot is being written.
+  CPSnapshot      snap;
+} CPSnapshotSlot;
+
+
 
 class AudioRouter {
   public:
-    AudioRouter(uint8_t, uint8_t, uint8_t);       // Constructor needs the i2c addresses of the three chips on the PCB.
+    AudioRouter(uint8_t, uint8_t, uint8_t, I2CAdapter* bus = NULL);   // Constructor needs the i2c addresses of the three chips on the PCB.
     ~AudioRouter(void);
 
     int8_t init(void);
+    int8_t refresh(void);     // Re-read the chips, and believe them over what we last wrote.
+    void   deferLatch(bool);  // Let commit() leave the switch latch on the bus thread, for settle() to collect.
+    int8_t settle(void);      // Wait out a deferred latch. If it failed, the outputs follow the switch.
     void preserveOnDestroy(bool);
     
     int8_t route(uint8_t col, uint8_t row);       // Establish a route to the given output from the given input.
@@ -102,15 +210,92 @@ class AudioRouter {
     int8_t unroute(uint8_t col, uint8_t row);     // Disconnect the given output from the given input.
     int8_t unroute(uint8_t col);                  // Disconnect the given output from all inputs.
 
+    int8_t routeMany(uint8_t row, uint8_t mask);  // Route one input to every output in the mask (bit n = output n).
+    int8_t unrouteInput(uint8_t row);             // Disconnect the given input from every output it feeds.
+    uint8_t getFanout(uint8_t row);               // Mask of the outputs the given input feeds.
+    uint8_t getRoute(uint8_t col);                // The input feeding the given output. AUDIO_ROUTER_UNBOUND if none.
+
+    /*
+    * Batches. Between begin() and commit(), route(), unroute() and setVolume() only
+    *   stage their changes. commit() applies only what differs: levels that are
+    *   dropping go first, then every switch change under a single latch, then levels
+    *   that are rising.
+    */
+    int8_t begin(void);
+    int8_t commit(void);                          // Returns error code. The batch is finished either way.
+    int8_t abort(void);                           // Throw away the staged changes.
+    bool   inBatch(void);
+
+    /*
+    * Scenes. A scene is a snapshot of every route, level, channel name and the enable
+    *   state. Recalling one works out what differs from the live state, ducks the
+    *   outputs whose routes are changing, moves all the switches under a single latch,
+    *   then brings the levels back. The plan for doing that is cached, so recalling the
+    *   same scene from the same state again costs only the bus traffic.
+    */
+    int8_t saveScene(uint8_t slot, const char* name = NULL);   // Capture the live state.
+    int8_t setScene(uint8_t slot, const char* name, const uint8_t row[8], const uint8_t vol[8], bool enabled);   // From elsewhere. Keeps the live names.
+    int8_t recallScene(uint8_t slot);
+    int8_t clearScene(uint8_t slot);
+    int8_t findScene(const char* name);           // Returns the slot, or AUDIO_ROUTER_ERROR_BAD_SCENE.
+    const CPScene* getScene(uint8_t slot);        // NULL if the slot is empty.
+    int8_t applyState(const uint8_t row[8], const uint8_t vol[8], bool enabled);   // Recall without a slot. Scenes are untouched.
+
     int8_t nameInput(uint8_t row, const char*);   // Name the input channel. 
     int8_t nameOutput(uint8_t col, const char*);  // Name the output channel. 
 
     int8_t setVolume(uint8_t col, uint8_t vol);   // Set the volume coming out of a given output channel.
+    int8_t setVolumes(const uint8_t vol[8]);      // Set all eight output volumes. One bus write per pot chip.
+    int8_t setVolumeDb(uint8_t col, int16_t db10);       // Set an output's level in dB x 10 (0 is full scale).
+    int8_t setVolumeNormalized(uint8_t col, uint8_t pos); // Set an output by fader position (0-255) on an audio taper.
+    int16_t getVolumeDb(uint8_t col);             // An output's level in dB x 10. VOLUME_TAPER_MUTE_DB10 if silent.
+    uint8_t getVolume(uint8_t col);               // An output's wiper value.
+
+    /*
+    * Volume ramps. fadeTo() only sets up the ramp. The actual movement happens in tick(),
+    *   which should be called often. Every output that moves in a given tick is written
+    *   in the same burst, so the bus cost depends on the tick rate, not on how many
+    *   outputs are fading. Explicitly setting an output's volume cancels its ramp.
+    */
+    int8_t fadeTo(uint8_t col, uint8_t vol, uint32_t duration_ms, uint8_t curve = AUDIO_ROUTER_CURVE_LINEAR);
+    int8_t stopFade(uint8_t col);                 // Leave the output wherever its ramp has gotten to.
+    bool   fading(void);                          // Is any output ramping?
+    bool   fading(uint8_t col);
+    int8_t tick(void);                            // Advance all ramps to millis().
+    int8_t tick(uint32_t now_ms);                 // Advance all ramps to the given time.
+    void   setRampPeriod(uint16_t ms);            // Ticks closer together than this don't move the ramps.
+
+    void   setWriteBack(bool enable, uint16_t flush_ms = 0);   // Defer pot writes until flush(), or every flush_ms.
+    int8_t flush(void);                           // Send any deferred pot writes.
 
     int8_t enable(void);      // Turn on the chips responsible for routing signals.
     int8_t disable(void);     // Turn off the chips responsible for routing signals.
 
-    int8_t status(char*);     // Write some status about the routes to the provided char buffer.
+    /*
+    * Snapshots. Every change to the routes, levels, names or enable state is published
+    *   once it has reached the hardware (for a batch, once it commits). Any thread may
+    *   read the latest one, without a lock and without touching the bus. Readers only
+    *   retry if the writer laps them, which takes AUDIO_ROUTER_SNAPSHOTS publishes
+    *   during a single copy.
+    */
+    void     snapshot(CPSnapshot*);
+    uint32_t generation(void);    // That of the latest snapshot.
+
+    /*
+    * The change feed. Each snapshot that differs from the last in its routes, levels
+    *   or enable state also leaves records of what changed, stamped with its generation.
+    *   (Names and health change generations without leaving records.) A poller takes a
+    *   snapshot once, then asks for whatever came after the newest generation it has
+    *   seen. Only whole generations are returned, so a buffer should have room for at
+    *   least AUDIO_ROUTER_MAX_CHANGES_PER_GEN. Returns the count copied, or
+    *   AUDIO_ROUTER_ERROR_OVERRUN if records the caller hasn't seen were already
+    *   dropped, in which case it should take a fresh snapshot. Safe from any thread.
+    */
+    int16_t  changesSince(uint32_t gen, CPChange* buf, uint16_t n);
+
+    int8_t status(char*, uint16_t len);   // Write some status about the routes into the buffer. Always terminated.
+
+    static uint16_t formatSnapshot(const CPSnapshot*, char* buf, uint16_t len);   // Returns the length written.
     
     // TODO: These ought to be statics...
     void dumpInputChannel(CPInputChannel *chan);
@@ -124,6 +309,16 @@ class AudioRouter {
     static constexpr const int8_t AUDIO_ROUTER_ERROR_BUS             = -2;   // We tried to unroute a signal from an output and failed.
     static constexpr const int8_t AUDIO_ROUTER_ERROR_BAD_COLUMN      = -3;   // Column was out-of-bounds.
     static constexpr const int8_t AUDIO_ROUTER_ERROR_BAD_ROW         = -4;   // Row was out-of-bounds.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_BAD_CURVE       = -5;   // Unknown ramp curve.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_IN_BATCH        = -6;   // A batch is already open.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_NO_BATCH        = -7;   // There is no batch to commit or abort.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_SHORT_CIRCUIT   = -8;   // The batch would have tied two inputs together.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_BAD_SCENE       = -9;   // Scene slot was out-of-bounds, empty, or not found.
+    static constexpr const int8_t AUDIO_ROUTER_ERROR_OVERRUN         = -10;  // The change feed no longer reaches back to the given generation.
+
+    static constexpr const uint8_t AUDIO_ROUTER_CURVE_LINEAR = 0;    // Equal wiper steps.
+    static constexpr const uint8_t AUDIO_ROUTER_CURVE_LOG    = 1;    // Equal dB steps. Sounds linear to a human.
+    static constexpr const uint8_t AUDIO_ROUTER_CURVE_SCURVE = 2;    // Eases in and out.
 
     
   private:
@@ -131,16 +326,54 @@ class AudioRouter {
   	uint8_t i2c_addr_dp_hi;
   	uint8_t i2c_addr_cp_switch;
   	
-    CPInputChannel*  inputs[12];
-    CPOutputChannel* outputs[8];
+    CPInputChannel  inputs[12];
+    CPOutputChannel outputs[8];
+    uint8_t         fanout[12];     // Per input, a mask of the outputs it feeds.
     
     ADG2128 *cp_switch;
-    ISL23345 *dp_lo;
-    ISL23345 *dp_hi;
+    ISL23345 *pots[2];         // The low pot serves outputs 0-3, and the high pot 4-7.
+
+    CPRamp   ramps[8];
+    CPScene  scenes[AUDIO_ROUTER_MAX_SCENES];
+
+    bool     batch_open;
+    uint8_t  staged_row[8];    // Per output. AUDIO_ROUTER_UNBOUND if unbound.
+    uint8_t  staged_vol[8];
+    uint8_t  staged_vol_mask;  // Outputs whose volume the batch has set.
+    uint32_t last_tick;
+    uint16_t ramp_period;
+
+    CPSnapshotSlot snaps[AUDIO_ROUTER_SNAPSHOTS];
+    uint32_t       snap_gen;   // The generation of the latest snapshot. It lives in slot (snap_gen % AUDIO_ROUTER_SNAPSHOTS).
+
+    CPChange       changes[AUDIO_ROUTER_CHANGE_RING];
+    uint32_t       change_head;     // Records ever written. The next goes in (change_head % AUDIO_ROUTER_CHANGE_RING).
+    uint32_t       change_tail;     // The oldest record still held.
+    uint32_t       evicted_gen;     // The generation of the newest record dropped to make room.
     
     CPOutputChannel* getOutputByCol(uint8_t);
+    int8_t init_chips(bool reread);
+    void   load_chips(void);
+    void   bind(uint8_t col, uint8_t row);
+    int8_t write_chip(uint8_t chip, const uint8_t vol[8]);
+
+    int8_t step_ramps(uint32_t now_ms);
+    int8_t write_levels(const uint8_t vol[8]);
+
+    bool   live_enabled(void);
+    void   capture(CPScene*, const char* name);
+    int8_t recall(CPScene*);
+    void   compile_scene(CPScene*);
+    int8_t run_plan(CPScene*);
+
+    void   publish(void);
+    void   record(uint32_t gen, uint8_t kind, uint8_t chan, uint8_t value);
+    int8_t apply_batch(void);
+
+    static uint8_t ramp_value(CPRamp*, uint32_t elapsed);
     
-    static const uint8_t col_remap[8];
+    static const uint8_t col_remap[8];    // Output to switch column.
+    static const uint8_t col_unmap[8];    // Switch column to output.
 };
 #endif
 
@@ -0,0 +1,233 @@
+/*
+File:   PresetLibrary.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef ARDUINO
+
+#include "PresetLibrary.h"
+#include "AudioRouter.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+
+static_assert(sizeof(PresetLibraryHeader) == 64, "The header should be 64 bytes.");
+static_assert(sizeof(PresetRecord) == 64, "A record should be 64 bytes.");
+
+
+PresetLibrary::PresetLibrary(void) {
+	fd       = -1;
+	writable = false;
+	map      = NULL;
+	map_len  = 0;
+	header   = NULL;
+	buckets  = NULL;
+	records  = NULL;
+}
+
+
+PresetLibrary::~PresetLibrary(void) {
+	close();
+}
+
+
+uint32_t PresetLibrary::map_size(uint32_t capacity, uint32_t bucket_count) {
+	return sizeof(PresetLibraryHeader) + (bucket_count * sizeof(uint32_t)) + (capacity * sizeof(PresetRecord));
+}
+
+
+/*
+* A new file is laid out under the lock, so two processes creating the same library
+*   at once can't both do it. The capacity is ignored for an existing file.
+*/
+int8_t PresetLibrary::open(const char* path, uint32_t capacity) {
+	close();
+	writable = true;
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		writable = false;
+		fd = ::open(path, O_RDONLY);
+	}
+	if (fd < 0) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to open %s.", path);
+		return PRESET_LIBRARY_ERROR_IO;
+	}
+
+	struct stat st;
+	if (writable) flock(fd, LOCK_EX);
+	if (0 != fstat(fd, &st)) st.st_size = 0;
+	if (writable && (0 == st.st_size) && (capacity > 0)) {
+		PresetLibraryHeader fresh;
+		memset(&fresh, 0x00, sizeof(fresh));
+		fresh.magic        = PRESET_LIBRARY_MAGIC;
+		fresh.version      = PRESET_LIBRARY_VERSION;
+		fresh.record_size  = sizeof(PresetRecord);
+		fresh.capacity     = capacity;
+		fresh.bucket_count = 1;
+		while (fresh.bucket_count < (capacity * 2)) fresh.bucket_count <<= 1;   // Keep the load under half.
+		if ((0 != ftruncate(fd, map_size(capacity, fresh.bucket_count))) ||
+			(sizeof(fresh) != pwrite(fd, &fresh, sizeof(fresh), 0)) ||
+			(0 != fstat(fd, &st))) {
+			flock(fd, LOCK_UN);
+			close();
+			return PRESET_LIBRARY_ERROR_IO;
+		}
+	}
+	if (writable) flock(fd, LOCK_UN);
+
+	PresetLibraryHeader h;
+	if ((st.st_size < (off_t) sizeof(h)) || (sizeof(h) != pread(fd, &h, sizeof(h), 0)) ||
+		(h.magic != PRESET_LIBRARY_MAGIC) || (h.version != PRESET_LIBRARY_VERSION) ||
+		(h.record_size != sizeof(PresetRecord)) || (0 == h.bucket_count) ||
+		(0 != (h.bucket_count & (h.bucket_count - 1))) ||
+		(st.st_size < (off_t) map_size(h.capacity, h.bucket_count))) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "%s is not a preset library.", path);
+		close();
+		return PRESET_LIBRARY_ERROR_FORMAT;
+	}
+
+	map_len = map_size(h.capacity, h.bucket_count);
+	void* m = mmap(NULL, map_len, (writable ? (PROT_READ | PROT_WRITE) : PROT_READ), MAP_SHARED, fd, 0);
+	if (MAP_FAILED == m) {
+		close();
+		return PRESET_LIBRARY_ERROR_IO;
+	}
+	map     = (uint8_t*) m;
+	header  = (PresetLibraryHeader*) map;
+	buckets = (uint32_t*) (map + sizeof(PresetLibraryHeader));
+	records = (PresetRecord*) (map + sizeof(PresetLibraryHeader) + (h.bucket_count * sizeof(uint32_t)));
+	return PRESET_LIBRARY_ERROR_NO_ERROR;
+}
+
+
+void PresetLibrary::close(void) {
+	if (NULL != map) munmap(map, map_len);
+	if (fd >= 0) ::close(fd);
+	fd      = -1;
+	map     = NULL;
+	map_len = 0;
+	header  = NULL;
+	buckets = NULL;
+	records = NULL;
+}
+
+
+bool PresetLibrary::isOpen(void) {
+	return (NULL != map);
+}
+
+
+uint32_t PresetLibrary::count(void) {
+	return (NULL == header) ? 0 : __atomic_load_n(&header->record_count, __ATOMIC_ACQUIRE);
+}
+
+
+uint32_t PresetLibrary::hash(const char* name) {
+	uint32_t h = 2166136261u;
+	while (*name) {
+		h ^= (uint8_t) *name++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+/*
+* The load factor is kept under half, so there is always an empty bucket to stop at.
+*/
+uint32_t PresetLibrary::probe(const char* name, uint32_t h) {
+	uint32_t mask = header->bucket_count - 1;
+	for (uint32_t b = h & mask; ; b = (b + 1) & mask) {
+		uint32_t slot = __atomic_load_n(&buckets[b], __ATOMIC_ACQUIRE);
+		if (0 == slot) return b;
+		PresetRecord* rec = &records[slot - 1];
+		if ((rec->hash == h) && (0 == strncmp(rec->name, name, PRESET_LIBRARY_NAME_LEN))) return b;
+	}
+}
+
+
+const PresetRecord* PresetLibrary::find(const char* name) {
+	if ((NULL == map) || (NULL == name)) return NULL;
+	uint32_t slot = __atomic_load_n(&buckets[probe(name, hash(name))], __ATOMIC_ACQUIRE);
+	return (0 == slot) ? NULL : &records[slot - 1];
+}
+
+
+const PresetRecord* PresetLibrary::get(uint32_t index) {
+	return (index < count()) ? &records[index] : NULL;
+}
+
+
+/*
+* Takes the routes as the AudioRouter has them: per output, the input feeding it.
+*/
+int8_t PresetLibrary::store(const char* name, const uint8_t row[8], const uint8_t vol[8], bool enabled) {
+	if (NULL == map) return PRESET_LIBRARY_ERROR_NOT_OPEN;
+	if (!writable)   return PRESET_LIBRARY_ERROR_IO;
+	if ((NULL == name) || (0 == *name) || (strlen(name) >= PRESET_LIBRARY_NAME_LEN)) {
+		return PRESET_LIBRARY_ERROR_BAD_NAME;
+	}
+	if (0 != flock(fd, LOCK_EX)) return PRESET_LIBRARY_ERROR_IO;
+
+	uint32_t n = header->record_count;
+	if (n >= header->capacity) {
+		flock(fd, LOCK_UN);
+		return PRESET_LIBRARY_ERROR_FULL;
+	}
+	PresetRecord* rec = &records[n];
+	memset(rec, 0x00, sizeof(PresetRecord));
+	strncpy(rec->name, name, PRESET_LIBRARY_NAME_LEN - 1);
+	for (uint8_t i = 0; i < 8; i++) {
+		if (row[i] < 12) rec->matrix[row[i]] |= (0x01 << i);
+	}
+	memcpy(rec->vol, vol, sizeof(rec->vol));
+	rec->flags = enabled ? PRESET_FLAG_ENABLED : 0;
+	rec->hash  = hash(name);
+
+	__atomic_store_n(&buckets[probe(name, rec->hash)], n + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&header->record_count, n + 1, __ATOMIC_RELEASE);
+	flock(fd, LOCK_UN);
+	return PRESET_LIBRARY_ERROR_NO_ERROR;
+}
+
+
+int8_t PresetLibrary::toRows(const PresetRecord* rec, uint8_t row[8]) {
+	memset(row, AUDIO_ROUTER_UNBOUND, 8);
+	for (uint8_t r = 0; r < 12; r++) {
+		for (uint8_t i = 0; i < 8; i++) {
+			if (0 == (rec->matrix[r] & (0x01 << i))) continue;
+			if (row[i] != AUDIO_ROUTER_UNBOUND) return PRESET_LIBRARY_ERROR_SHORT_CIRCUIT;
+			row[i] = r;
+		}
+	}
+	return PRESET_LIBRARY_ERROR_NO_ERROR;
+}
+
+#endif  // ARDUINO
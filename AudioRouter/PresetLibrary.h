@@ -0,0 +1,125 @@
+/*
+File:   PresetLibrary.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+An on-disk library of named presets for one board, used through mmap().
+
+The file is sized for its capacity when it is created, and never grows. So
+every process that has it mapped sees the same bytes, and a preset written by
+one is visible to the others as soon as it is published. Nothing is parsed on
+open: a lookup is a hash, a probe of the bucket table, and a pointer into the
+map.
+
+File format (host byte order):
+  Header:   PresetLibraryHeader, padded to 64 bytes.
+  Buckets:  bucket_count uint32s. Each is a record index + 1, or 0 if empty.
+            Open addressing with linear probing on the FNV-1a hash of the name.
+  Records:  capacity PresetRecords, in the order they were written.
+
+Writers hold flock() on the file. A record is written in full before the
+bucket that points to it, and the bucket before the record count, all with
+release stores. Storing a name that already exists appends a new record and
+repoints its bucket, so readers never see a record change underneath them.
+Replaced records are simply orphaned.
+*/
+
+
+#ifndef PRESET_LIBRARY_H
+#define PRESET_LIBRARY_H
+
+#ifndef ARDUINO
+  #include <inttypes.h>
+
+  #define PRESET_LIBRARY_MAGIC            0x4C505356   // "VSPL"
+  #define PRESET_LIBRARY_VERSION          1
+  #define PRESET_LIBRARY_NAME_LEN         32           // Including the terminator.
+  #define PRESET_LIBRARY_DEFAULT_CAPACITY 4096
+
+  #define PRESET_FLAG_ENABLED             0x01         // The board was enabled.
+
+
+  // This struct is the head of the file.
+  typedef struct preset_library_header_t {
+    uint32_t      magic;
+    uint16_t      version;
+    uint16_t      record_size;     // sizeof(PresetRecord), as a sanity check.
+    uint32_t      bucket_count;    // Always a power of two.
+    uint32_t      capacity;        // How many records the file has room for.
+    uint32_t      record_count;    // How many have been written. Only ever grows.
+    uint8_t       reserved[44];
+  } PresetLibraryHeader;
+
+
+  // This struct is one preset.
+  typedef struct preset_record_t {
+    char          name[PRESET_LIBRARY_NAME_LEN];
+    uint8_t       matrix[12];      // Per input, a mask of the outputs it feeds (bit n = output n).
+    uint8_t       vol[8];          // Per output wiper values.
+    uint8_t       flags;           // PRESET_FLAG_*
+    uint8_t       reserved[7];
+    uint32_t      hash;            // FNV-1a of the name.
+  } PresetRecord;
+
+
+  class PresetLibrary {
+    public:
+      PresetLibrary(void);
+      ~PresetLibrary(void);
+
+      int8_t   open(const char* path, uint32_t capacity = PRESET_LIBRARY_DEFAULT_CAPACITY);   // Creates the file if need be.
+      void     close(void);
+      bool     isOpen(void);
+
+      uint32_t count(void);                      // Records written, including replaced ones.
+      const PresetRecord* find(const char* name);
+      const PresetRecord* get(uint32_t index);   // By position in the file.
+
+      int8_t   store(const char* name, const uint8_t row[8], const uint8_t vol[8], bool enabled);
+
+      static int8_t   toRows(const PresetRecord*, uint8_t row[8]);   // Matrix to per-output rows.
+      static uint32_t hash(const char* name);
+
+      // These don't overlap the router's codes, so they can be handed up as they are.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_NO_ERROR      = 0;
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_IO            = -40;   // Couldn't open, size, map or lock the file.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_FORMAT        = -41;   // The file isn't a preset library we understand.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_FULL          = -42;   // No room for another record.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_BAD_NAME      = -43;   // Empty, or too long.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_SHORT_CIRCUIT = -44;   // The record has an output fed by two inputs.
+      static constexpr const int8_t PRESET_LIBRARY_ERROR_NOT_OPEN      = -45;   // There is no library open.
+
+    private:
+      int       fd;
+      bool      writable;
+      uint8_t*  map;
+      uint32_t  map_len;
+      PresetLibraryHeader* header;
+      uint32_t* buckets;
+      PresetRecord* records;
+
+      uint32_t  probe(const char* name, uint32_t h);   // The bucket holding the name, or the empty one where it would go.
+      static uint32_t map_size(uint32_t capacity, uint32_t bucket_count);
+  };
+
+#endif  // ARDUINO
+#endif
@@ -0,0 +1,316 @@
+/*
+File:   RouterConsole.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "RouterConsole.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef ARDUINO
+  #include "PresetLibrary.h"
+#endif
+
+
+RouterConsole::RouterConsole(RouterFabric* f) {
+	fabric  = f;
+#ifndef ARDUINO
+	presets = NULL;
+#endif
+}
+
+
+RouterConsole::~RouterConsole(void) {
+}
+
+
+#ifndef ARDUINO
+void RouterConsole::setPresets(PresetLibrary* lib) {
+	presets = lib;
+}
+#endif
+
+
+const char* RouterConsole::resultString(int8_t result) {
+	switch (result) {
+		case AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR:        return "Operation completed with success.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_INPUT_DISPLACED: return "Operation completed with success, but we displaced a previously established route.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN:      return "Error: Output channel is out of range.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW:         return "Error: Input channel is out of range.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_UNROUTE_FAILED:  return "Error: Failed to unroute the given channels.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_BAD_CURVE:       return "Error: Unknown fade curve.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_IN_BATCH:        return "Error: A batch is already open.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_NO_BATCH:        return "Error: There is no batch open.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_SHORT_CIRCUIT:   return "Error: That would have tied two inputs together.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_BAD_SCENE:       return "Error: The scene couldn't be saved or recalled.";
+		case AudioRouter::AUDIO_ROUTER_ERROR_OVERRUN:         return "Error: Changes since then were dropped. Take a fresh status.";
+		case RouterFabric::ROUTER_FABRIC_ERROR_NO_PATH:       return "Error: There is no free path between that input and output.";
+		case RouterFabric::ROUTER_FABRIC_ERROR_BUS:           return "Error: Writes failed on one of the buses.";
+		case RouterFabric::ROUTER_FABRIC_ERROR_LINKED:        return "Error: That channel is part of a link between boards.";
+		case ROUTER_CONSOLE_ERROR_SYNTAX:                     return "Error: Bad arguments for that command.";
+		case ROUTER_CONSOLE_ERROR_UNKNOWN:                    return "Error: Unknown command.";
+#ifndef ARDUINO
+		case PresetLibrary::PRESET_LIBRARY_ERROR_IO:          return "Error: The preset library couldn't be read or written.";
+		case PresetLibrary::PRESET_LIBRARY_ERROR_FORMAT:      return "Error: The preset file isn't a preset library.";
+		case PresetLibrary::PRESET_LIBRARY_ERROR_FULL:        return "Error: The preset library is full.";
+		case PresetLibrary::PRESET_LIBRARY_ERROR_BAD_NAME:    return "Error: Preset names must be 1-31 characters.";
+		case PresetLibrary::PRESET_LIBRARY_ERROR_SHORT_CIRCUIT: return "Error: That preset would tie two inputs together.";
+		case PresetLibrary::PRESET_LIBRARY_ERROR_NOT_OPEN:    return "Error: There is no preset library open.";
+#endif
+		default:                                              return "Error: Unhandled case.";
+	}
+}
+
+
+/*
+* Numbers may be given in decimal or hex, but must be entirely numbers.
+*/
+bool RouterConsole::parse_num(const char* str, uint32_t max, uint32_t* val) {
+	if ((NULL == str) || (0 == *str)) return false;
+	char* end = NULL;
+	unsigned long x = strtoul(str, &end, 0);
+	if ((0 != *end) || (x > max)) return false;
+	*val = (uint32_t) x;
+	return true;
+}
+
+
+int8_t RouterConsole::execute(char* line, char* reply, uint16_t reply_len) {
+	char* argv[ROUTER_CONSOLE_MAX_ARGS];
+	uint8_t argc = 0;
+	char* save = NULL;
+	for (char* tok = strtok_r(line, " \t\r\n", &save); (NULL != tok) && (argc < ROUTER_CONSOLE_MAX_ARGS); tok = strtok_r(NULL, " \t\r\n", &save)) {
+		argv[argc++] = tok;
+	}
+	if (reply_len > 0) *reply = 0;
+	if (0 == argc) return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;   // Blank lines cost nothing.
+
+	const char* cmd = argv[0];
+	uint32_t a = 0;
+	uint32_t b = 0;
+	uint32_t c = 0;
+
+	if (0 == strcmp(cmd, "route")) {
+		if ((argc != 3) || !parse_num(argv[1], 255, &a) || !parse_num(argv[2], 255, &b)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return fabric->route(a, b);
+	}
+	else if (0 == strcmp(cmd, "unroute")) {
+		if ((argc < 2) || (argc > 3) || !parse_num(argv[1], 255, &a)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		if (argc == 2) return fabric->unroute(a);
+		if (!parse_num(argv[2], 255, &b)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return fabric->unroute(a, b);
+	}
+	else if (0 == strcmp(cmd, "unroute-input")) {
+		if ((argc != 2) || !parse_num(argv[1], 255, &a)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return fabric->unrouteInput(a);
+	}
+	else if (0 == strcmp(cmd, "volume")) {
+		if ((argc != 3) || !parse_num(argv[2], 255, &b)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return levels(argv[1], b, 0, 0, false);
+	}
+	else if (0 == strcmp(cmd, "mute")) {
+		if (argc != 2) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return levels(argv[1], 0, 0, 0, false);
+	}
+	else if (0 == strcmp(cmd, "scene")) {
+		if ((argc >= 3) && (argc <= 4) && (0 == strcmp(argv[1], "save"))) {
+			if (!parse_num(argv[2], AUDIO_ROUTER_MAX_SCENES - 1, &a)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+			return fabric->saveScene(a, (argc == 4) ? argv[3] : NULL);
+		}
+		if ((argc == 3) && (0 == strcmp(argv[1], "recall"))) {
+			if (parse_num(argv[2], AUDIO_ROUTER_MAX_SCENES - 1, &a)) return fabric->recallScene(a);
+			int8_t slot = fabric->findScene(argv[2]);
+			return (slot < 0) ? slot : fabric->recallScene(slot);
+		}
+		return ROUTER_CONSOLE_ERROR_SYNTAX;
+	}
+	else if (0 == strcmp(cmd, "fade")) {
+		if ((argc < 4) || (argc > 5) || !parse_num(argv[2], 255, &b) || !parse_num(argv[3], 0xFFFFFFFF, &c)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		uint8_t curve = AudioRouter::AUDIO_ROUTER_CURVE_LOG;
+		if (argc == 5) {
+			if (0 == strcmp(argv[4], "linear"))      curve = AudioRouter::AUDIO_ROUTER_CURVE_LINEAR;
+			else if (0 == strcmp(argv[4], "log"))    curve = AudioRouter::AUDIO_ROUTER_CURVE_LOG;
+			else if (0 == strcmp(argv[4], "scurve")) curve = AudioRouter::AUDIO_ROUTER_CURVE_SCURVE;
+			else return AudioRouter::AUDIO_ROUTER_ERROR_BAD_CURVE;
+		}
+		return levels(argv[1], b, c, curve, true);
+	}
+	else if ((argc == 1) && (0 == strcmp(cmd, "begin")))   return fabric->begin();
+	else if ((argc == 1) && (0 == strcmp(cmd, "commit")))  return fabric->commit();
+	else if ((argc == 1) && (0 == strcmp(cmd, "abort")))   return fabric->abort();
+	else if ((argc == 1) && (0 == strcmp(cmd, "enable")))  return fabric->enable();
+	else if ((argc == 1) && (0 == strcmp(cmd, "disable"))) return fabric->disable();
+	else if ((argc == 1) && (0 == strcmp(cmd, "reset"))) {
+		fabric->disable();
+		return fabric->enable();
+	}
+	else if ((argc == 1) && (0 == strcmp(cmd, "status"))) {
+		return status(reply, reply_len);
+	}
+	else if (0 == strcmp(cmd, "changes")) {
+		if ((argc < 2) || (argc > 3) || !parse_num(argv[1], 0xFFFFFFFF, &a)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		if ((argc == 3) && !parse_num(argv[2], fabric->boardCount() - 1, &b)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return changes(b, a, reply, reply_len);
+	}
+	else if ((argc == 1) && (0 == strcmp(cmd, "help"))) {
+		snprintf(reply, reply_len,
+			"route OUT IN | unroute OUT [IN] | unroute-input IN\n"
+			"volume OUT|all VOL | fade OUT|all VOL MS [linear|log|scurve] | mute OUT|all\n"
+			"scene save SLOT [NAME] | scene recall SLOT|NAME\n"
+			"begin | commit | abort | enable | disable | reset | status | changes GEN [BOARD]\n"
+			"preset NAME | preset-save NAME\n");
+		return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+#ifndef ARDUINO
+	else if (0 == strcmp(cmd, "preset")) {
+		if (argc != 2) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return preset(argv[1]);
+	}
+	else if (0 == strcmp(cmd, "preset-save")) {
+		if (argc != 2) return ROUTER_CONSOLE_ERROR_SYNTAX;
+		return preset_save(argv[1]);
+	}
+#endif
+	return ROUTER_CONSOLE_ERROR_UNKNOWN;
+}
+
+
+/*
+* "all" skips the outputs that belong to links, rather than failing on them.
+*/
+int8_t RouterConsole::levels(char* out_arg, uint8_t vol, uint32_t ms, uint8_t curve, bool fade) {
+	uint32_t out = 0;
+	if (0 == strcmp(out_arg, "all")) {
+		if (!fade) return fabric->setVolumeAll(vol);
+		for (uint8_t i = 0; i < fabric->outputCount(); i++) {
+			int8_t result = fabric->fadeTo(i, vol, ms, curve);
+			if ((result < 0) && (result != RouterFabric::ROUTER_FABRIC_ERROR_LINKED)) return result;
+		}
+		return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	}
+	if (!parse_num(out_arg, 255, &out)) return ROUTER_CONSOLE_ERROR_SYNTAX;
+	return fade ? fabric->fadeTo(out, vol, ms, curve) : fabric->setVolume(out, vol);
+}
+
+
+/*
+* One line per output: what feeds it, and its level. Taken from each board's latest
+*   snapshot, so this costs no bus traffic.
+*/
+int8_t RouterConsole::status(char* reply, uint16_t reply_len) {
+	uint16_t   n = 0;
+	CPSnapshot snap;
+	for (uint8_t o = 0; (o < fabric->outputCount()) && (n < reply_len); o++) {
+		if (0 == (o % 8)) fabric->getBoard(o / 8)->snapshot(&snap);
+		uint8_t row = snap.row[o % 8];
+		if (row == AUDIO_ROUTER_UNBOUND) {
+			n += snprintf(reply + n, reply_len - n, "out %u: unbound, level %u\n", o, snap.vol[o % 8]);
+		}
+		else {
+			n += snprintf(reply + n, reply_len - n, "out %u: in %u, level %u\n", o, ((o / 8) * 12) + row, snap.vol[o % 8]);
+		}
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* The board's generation as of now, then one line per change after the given one.
+*   Channels are global. A poller carries on from the later of the generation and the
+*   last change listed.
+*/
+int8_t RouterConsole::changes(uint8_t board, uint32_t since, char* reply, uint16_t reply_len) {
+	AudioRouter* router = fabric->getBoard(board);
+	if (NULL == router) return ROUTER_CONSOLE_ERROR_SYNTAX;
+	CPChange buf[AUDIO_ROUTER_CHANGE_RING];
+	uint32_t now   = router->generation();
+	int16_t  count = router->changesSince(since, buf, AUDIO_ROUTER_CHANGE_RING);
+	if (count < 0) return count;
+
+	uint16_t n = snprintf(reply, reply_len, "generation %u\n", (unsigned) now);
+	for (int16_t i = 0; (i < count) && (n < reply_len); i++) {
+		CPChange* c = &buf[i];
+		unsigned out = (board * 8) + c->chan;
+		unsigned in  = (board * 12) + c->value;
+		switch (c->kind) {
+			case AUDIO_ROUTER_CHANGE_ROUTE:   n += snprintf(reply + n, reply_len - n, "%u route %u %u\n", (unsigned) c->generation, out, in);    break;
+			case AUDIO_ROUTER_CHANGE_UNROUTE: n += snprintf(reply + n, reply_len - n, "%u unroute %u %u\n", (unsigned) c->generation, out, in);  break;
+			case AUDIO_ROUTER_CHANGE_LEVEL:   n += snprintf(reply + n, reply_len - n, "%u volume %u %u\n", (unsigned) c->generation, out, c->value);  break;
+			case AUDIO_ROUTER_CHANGE_ENABLE:  n += snprintf(reply + n, reply_len - n, "%u enable\n", (unsigned) c->generation);   break;
+			case AUDIO_ROUTER_CHANGE_DISABLE: n += snprintf(reply + n, reply_len - n, "%u disable\n", (unsigned) c->generation);  break;
+			default:  break;
+		}
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+#ifndef ARDUINO
+/*
+* Presets are for one board, so they apply to the first. They go straight to it,
+*   around the fabric. So a preset must leave alone
+*   anything a link between boards depends on, the same way the fabric would: no new
+*   route on or off a linked channel, and no level change on a link output. If the
+*   board has links, it can't be switched off or on by a preset either.
+*/
+int8_t RouterConsole::preset(const char* name) {
+	if (NULL == presets) return PresetLibrary::PRESET_LIBRARY_ERROR_NOT_OPEN;
+	const PresetRecord* rec = presets->find(name);
+	if (NULL == rec) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_SCENE;
+	uint8_t rows[8];
+	int8_t result = PresetLibrary::toRows(rec, rows);
+	if (result != PresetLibrary::PRESET_LIBRARY_ERROR_NO_ERROR) return result;
+	AudioRouter* board = fabric->getBoard(0);
+	if (fabric->inBatch()) return AudioRouter::AUDIO_ROUTER_ERROR_IN_BATCH;
+
+	CPSnapshot snap;
+	board->snapshot(&snap);
+	bool linked = false;
+	for (uint8_t o = 0; o < 8; o++) {
+		bool out_linked = fabric->isLinked(o, AUDIO_ROUTER_UNBOUND);
+		if (rows[o] != snap.row[o]) {
+			if (out_linked) return RouterFabric::ROUTER_FABRIC_ERROR_LINKED;
+			if ((snap.row[o] != AUDIO_ROUTER_UNBOUND) && fabric->isLinked(AUDIO_ROUTER_UNBOUND, snap.row[o])) return RouterFabric::ROUTER_FABRIC_ERROR_LINKED;
+			if ((rows[o] != AUDIO_ROUTER_UNBOUND) && fabric->isLinked(AUDIO_ROUTER_UNBOUND, rows[o])) return RouterFabric::ROUTER_FABRIC_ERROR_LINKED;
+		}
+		if (out_linked && (rec->vol[o] != snap.vol[o])) return RouterFabric::ROUTER_FABRIC_ERROR_LINKED;
+		linked = linked || out_linked;
+	}
+	for (uint8_t i = 0; i < 12; i++) linked = linked || fabric->isLinked(AUDIO_ROUTER_UNBOUND, i);
+	bool enabled = (rec->flags & PRESET_FLAG_ENABLED);
+	if (linked && (enabled != snap.enabled)) return RouterFabric::ROUTER_FABRIC_ERROR_LINKED;
+
+	result = board->applyState(rows, rec->vol, enabled);
+	fabric->resync();
+	return result;
+}
+
+
+int8_t RouterConsole::preset_save(const char* name) {
+	if (NULL == presets) return PresetLibrary::PRESET_LIBRARY_ERROR_NOT_OPEN;
+	CPSnapshot snap;
+	fabric->getBoard(0)->snapshot(&snap);
+	return presets->store(name, snap.row, snap.vol, snap.enabled);
+}
+#endif
@@ -0,0 +1,91 @@
+/*
+File:   RouterConsole.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+A line-oriented command interpreter for a RouterFabric.
+
+This is what the daemon runs each line it is sent through, but nothing here
+knows about sockets, so it could as well be fed from a serial port. Channel
+numbers are global, as RouterFabric has them.
+
+  route OUT IN              unroute OUT [IN]          unroute-input IN
+  volume OUT|all VOL        fade OUT|all VOL MS [linear|log|scurve]
+  mute OUT|all
+  scene save SLOT [NAME]    scene recall SLOT|NAME
+  begin                     commit                    abort
+  enable                    disable                   reset
+  status                    changes GEN [BOARD]       help
+  preset NAME               preset-save NAME          (linux, with a library)
+
+execute() returns the result code of the command, and writes anything it has
+to say into the reply buffer. resultString() turns a code into words.
+*/
+
+
+#ifndef ROUTER_CONSOLE_H
+#define ROUTER_CONSOLE_H
+
+#include "RouterFabric.h"
+
+#ifndef ARDUINO
+  class PresetLibrary;
+#endif
+
+#define ROUTER_CONSOLE_MAX_ARGS   6
+
+
+class RouterConsole {
+  public:
+    RouterConsole(RouterFabric*);
+    ~RouterConsole(void);
+
+#ifndef ARDUINO
+    void   setPresets(PresetLibrary*);       // We do not take ownership.
+#endif
+
+    int8_t execute(char* line, char* reply, uint16_t reply_len);   // The line is cut up in the process.
+
+    static const char* resultString(int8_t);
+
+    static constexpr const int8_t ROUTER_CONSOLE_ERROR_SYNTAX  = -30;   // Wrong arguments for the command.
+    static constexpr const int8_t ROUTER_CONSOLE_ERROR_UNKNOWN = -31;   // No such command.
+
+
+  private:
+    RouterFabric*  fabric;
+#ifndef ARDUINO
+    PresetLibrary* presets;
+#endif
+
+    int8_t status(char* reply, uint16_t reply_len);
+    int8_t changes(uint8_t board, uint32_t since, char* reply, uint16_t reply_len);
+    int8_t levels(char* out_arg, uint8_t vol, uint32_t ms, uint8_t curve, bool fade);
+#ifndef ARDUINO
+    int8_t preset(const char* name);
+    int8_t preset_save(const char* name);
+#endif
+
+    static bool parse_num(const char* str, uint32_t max, uint32_t* val);
+};
+
+#endif
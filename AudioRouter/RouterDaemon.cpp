@@ -0,0 +1,265 @@
+/*
+File:   RouterDaemon.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef ARDUINO
+
+#include "RouterDaemon.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+
+RouterDaemon::RouterDaemon(RouterFabric* f, RouterConsole* c) {
+	fabric    = f;
+	console   = c;
+	state_page = NULL;
+	listen_fd = -1;
+	running   = false;
+	sock_path[0] = 0;
+	for (uint8_t i = 0; i < ROUTER_DAEMON_MAX_CLIENTS; i++) clients[i].fd = -1;
+}
+
+
+RouterDaemon::~RouterDaemon(void) {
+	for (uint8_t i = 0; i < ROUTER_DAEMON_MAX_CLIENTS; i++) drop(&clients[i]);
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		unlink(sock_path);
+	}
+}
+
+
+void RouterDaemon::setStatePage(StatePage* page) {
+	state_page = page;
+	if (NULL != state_page) state_page->publish(fabric);
+}
+
+
+int8_t RouterDaemon::listen(const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) return ROUTER_DAEMON_ERROR_SOCKET;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	// If something answers on the path, leave it be. If not, the file is left over
+	//   from a daemon that died, and can go.
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe >= 0) {
+		bool live = (0 == connect(probe, (struct sockaddr*) &addr, sizeof(addr)));
+		close(probe);
+		if (live) return ROUTER_DAEMON_ERROR_IN_USE;
+	}
+	unlink(path);
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((listen_fd < 0) ||
+		(0 != bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr))) ||
+		(0 != ::listen(listen_fd, ROUTER_DAEMON_MAX_CLIENTS))) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to listen on %s: %s", path, strerror(errno));
+		if (listen_fd >= 0) close(listen_fd);
+		listen_fd = -1;
+		return ROUTER_DAEMON_ERROR_SOCKET;
+	}
+	strncpy(sock_path, path, sizeof(sock_path) - 1);
+	sock_path[sizeof(sock_path) - 1] = 0;
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Listening on %s.", sock_path);
+	return ROUTER_DAEMON_ERROR_NO_ERROR;
+}
+
+
+void RouterDaemon::stop(void) {
+	running = false;
+}
+
+
+/*
+* Everything happens on this thread, so the fabric never sees two callers at once.
+*/
+int8_t RouterDaemon::serve(void) {
+	if (listen_fd < 0) return ROUTER_DAEMON_ERROR_SOCKET;
+	struct pollfd fds[ROUTER_DAEMON_MAX_CLIENTS + 1];
+	RouterDaemonClient* owner[ROUTER_DAEMON_MAX_CLIENTS + 1];
+	running = true;
+	while (running) {
+		nfds_t n = 0;
+		fds[n].fd     = listen_fd;
+		fds[n].events = POLLIN;
+		owner[n++]    = NULL;
+		for (uint8_t i = 0; i < ROUTER_DAEMON_MAX_CLIENTS; i++) {
+			if (clients[i].fd < 0) continue;
+			fds[n].fd     = clients[i].fd;
+			fds[n].events = POLLIN;
+			owner[n++]    = &clients[i];
+		}
+
+		int timeout = fabric->fading() ? AUDIO_ROUTER_RAMP_PERIOD_MS : 1000;
+		int ready   = poll(fds, n, timeout);
+		if ((ready < 0) && (errno != EINTR)) {
+			logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "poll() failed: %s", strerror(errno));
+			break;
+		}
+		fabric->tick();   // Ramps, and any pot writes being held back.
+		if (ready > 0) {
+			if (fds[0].revents & POLLIN) accept_client();
+			for (nfds_t i = 1; i < n; i++) {
+				if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+					if (!service(owner[i])) drop(owner[i]);
+				}
+			}
+		}
+		if (NULL != state_page) state_page->publish(fabric);
+	}
+	return ROUTER_DAEMON_ERROR_NO_ERROR;
+}
+
+
+void RouterDaemon::accept_client(void) {
+	int fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0) return;
+	for (uint8_t i = 0; i < ROUTER_DAEMON_MAX_CLIENTS; i++) {
+		if (clients[i].fd < 0) {
+			clients[i].fd  = fd;
+			clients[i].len = 0;
+			return;
+		}
+	}
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_WARNING, "Too many clients. Turning one away.");
+	close(fd);
+}
+
+
+void RouterDaemon::drop(RouterDaemonClient* client) {
+	if (client->fd >= 0) close(client->fd);
+	client->fd  = -1;
+	client->len = 0;
+}
+
+
+/*
+* Read what the client has for us, and answer every complete line in it.
+*/
+bool RouterDaemon::service(RouterDaemonClient* client) {
+	ssize_t got = read(client->fd, client->line + client->len, sizeof(client->line) - 1 - client->len);
+	if (got <= 0) return false;
+	client->len += got;
+
+	char* start = client->line;
+	char* end;
+	while (NULL != (end = (char*) memchr(start, '\n', client->len - (start - client->line)))) {
+		*end = 0;
+		if (!answer(client, start)) return false;
+		start = end + 1;
+	}
+	client->len -= (start - client->line);
+	memmove(client->line, start, client->len);
+
+	if (client->len >= sizeof(client->line) - 1) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_WARNING, "Dropping a client for sending an over-long line.");
+		return false;
+	}
+	return true;
+}
+
+
+/*
+* The loop can't wait on one client. If a client has stopped reading, and the socket
+*   has no room for the reply, the client is dropped.
+*/
+bool RouterDaemon::answer(RouterDaemonClient* client, char* line) {
+	int8_t  result = console->execute(line, reply, sizeof(reply));
+	size_t  len    = strlen(reply);
+	snprintf(reply + len, sizeof(reply) - len, "= %d %s\n", result, RouterConsole::resultString(result));
+	len = strlen(reply);
+	for (size_t sent = 0; sent < len; ) {
+		ssize_t w = ::send(client->fd, reply + sent, len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (w <= 0) {
+			if ((w < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+				logger.unified_log(__PRETTY_FUNCTION__, LOG_WARNING, "Dropping a client that isn't reading its replies.");
+			}
+			return false;
+		}
+		sent += w;
+	}
+	return true;
+}
+
+
+/**************************************************************************
+* The client side...                                                      *
+**************************************************************************/
+
+int8_t RouterDaemon::send(const char* path, const char* command, char* reply, uint16_t reply_len) {
+	struct sockaddr_un addr;
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd < 0) || (0 != connect(fd, (struct sockaddr*) &addr, sizeof(addr)))) {
+		if (fd >= 0) close(fd);
+		return ROUTER_DAEMON_ERROR_CONNECT;
+	}
+	size_t len = strlen(command);
+	if ((write(fd, command, len) != (ssize_t) len) || (write(fd, "\n", 1) != 1)) {
+		close(fd);
+		return ROUTER_DAEMON_ERROR_CONNECT;
+	}
+
+	// Read until the result line has arrived in full.
+	char    buf[ROUTER_DAEMON_REPLY_LEN];
+	size_t  have   = 0;
+	char*   result = NULL;
+	while (have < sizeof(buf) - 1) {
+		ssize_t got = read(fd, buf + have, sizeof(buf) - 1 - have);
+		if (got <= 0) break;
+		have += got;
+		buf[have] = 0;
+		result = (0 == strncmp(buf, "= ", 2)) ? buf : strstr(buf, "\n= ");
+		if ((NULL != result) && (result != buf)) result++;
+		if ((NULL != result) && (NULL != strchr(result, '\n'))) break;
+		result = NULL;
+	}
+	close(fd);
+	if (NULL == result) return ROUTER_DAEMON_ERROR_CONNECT;
+
+	if (reply_len > 0) {
+		size_t body = result - buf;
+		if (body >= reply_len) body = reply_len - 1;
+		memcpy(reply, buf, body);
+		reply[body] = 0;
+	}
+	return (int8_t) atoi(result + 2);
+}
+
+#endif  // ARDUINO
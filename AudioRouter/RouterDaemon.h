@@ -0,0 +1,106 @@
+/*
+File:   RouterDaemon.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+A long-running owner for the bus, controlled over a Unix-domain socket.
+
+The daemon keeps the fabric (and so every driver's view of the hardware)
+alive between commands. A command costs a socket round trip and whatever bus
+writes it actually needs, rather than a process start and a full readback.
+
+The protocol is lines of text. Each line a client sends is run through a
+RouterConsole, and answered with whatever the console had to say, followed
+by a line of the form:
+  = <result code> <result string>
+A client may send as many lines as it likes on one connection. They are
+answered in order.
+
+While anything is fading, the daemon wakes every ramp period to tick() the
+fabric. Otherwise it sleeps until a client has something to say, or a second
+has passed. If it has a state page, the page is brought up to date each time
+it wakes.
+*/
+
+
+#ifndef ROUTER_DAEMON_H
+#define ROUTER_DAEMON_H
+
+#ifndef ARDUINO
+  #include "RouterConsole.h"
+  #include "StatePage.h"
+
+  #define ROUTER_DAEMON_DEFAULT_SOCKET  "/tmp/audioroute.sock"
+  #define ROUTER_DAEMON_MAX_CLIENTS     8
+  #define ROUTER_DAEMON_LINE_LEN        256
+  #define ROUTER_DAEMON_REPLY_LEN       4096
+
+
+  // This struct is one connected client.
+  typedef struct router_daemon_client_t {
+    int           fd;              // -1 if the slot is free.
+    uint16_t      len;             // Bytes waiting in line.
+    char          line[ROUTER_DAEMON_LINE_LEN];
+  } RouterDaemonClient;
+
+
+  class RouterDaemon {
+    public:
+      RouterDaemon(RouterFabric*, RouterConsole*);   // We do not take ownership of either.
+      ~RouterDaemon(void);
+
+      void   setStatePage(StatePage*);   // Created by the caller. We do not take ownership.
+      int8_t listen(const char* path);   // Replaces a stale socket file, but not a live daemon.
+      int8_t serve(void);                // Runs until stop().
+      void   stop(void);                 // Safe to call from a signal handler.
+
+      /*
+      * The client side. Sends one command and waits for its answer. The reply holds
+      *   everything before the result line. Returns the result code, or
+      *   ROUTER_DAEMON_ERROR_CONNECT if the daemon couldn't be reached.
+      */
+      static int8_t send(const char* path, const char* command, char* reply, uint16_t reply_len);
+
+      static constexpr const int8_t ROUTER_DAEMON_ERROR_NO_ERROR = 0;
+      static constexpr const int8_t ROUTER_DAEMON_ERROR_SOCKET   = -40;   // Couldn't create, bind or listen.
+      static constexpr const int8_t ROUTER_DAEMON_ERROR_IN_USE   = -41;   // Another daemon is answering on that path.
+      static constexpr const int8_t ROUTER_DAEMON_ERROR_CONNECT  = -42;   // Nobody is answering on that path.
+
+
+    private:
+      RouterFabric*  fabric;
+      RouterConsole* console;
+      StatePage*     state_page;
+      int            listen_fd;
+      volatile bool  running;
+      char           sock_path[108];
+      RouterDaemonClient clients[ROUTER_DAEMON_MAX_CLIENTS];
+      char           reply[ROUTER_DAEMON_REPLY_LEN];
+
+      void accept_client(void);
+      bool service(RouterDaemonClient*);     // Returns false if the client went away.
+      void drop(RouterDaemonClient*);
+      bool answer(RouterDaemonClient*, char* line);   // Returns false if the client can't take the reply.
+  };
+
+#endif  // ARDUINO
+#endif
@@ -0,0 +1,625 @@
+/*
+File:   RouterFabric.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "RouterFabric.h"
+#include "../i2c-adapter/i2c-adapter.h"
+#include <string.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+extern I2CAdapter *i2c;
+
+
+RouterFabric::RouterFabric(void) {
+	board_count = 0;
+	link_count  = 0;
+	batch_open  = false;
+	own_workers = false;
+	memset(&plan, 0x00, sizeof(plan));
+	memset(plan.src, AUDIO_ROUTER_UNBOUND, sizeof(plan.src));
+}
+
+
+RouterFabric::~RouterFabric(void) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		delete boards[i].router;
+		boards[i].router = NULL;
+	}
+#ifndef ARDUINO
+	if (own_workers) stopWorkers();
+#endif
+}
+
+
+/*
+* The board is brought up against its bus right away. If no bus is given, the global
+*   one is used.
+*/
+int8_t RouterFabric::addBoard(I2CAdapter* bus, uint8_t cp_addr, uint8_t dp_lo_addr, uint8_t dp_hi_addr) {
+	if (board_count >= ROUTER_FABRIC_MAX_BOARDS) return ROUTER_FABRIC_ERROR_FULL;
+	FabricBoard* b = &boards[board_count];
+	b->bus        = (NULL != bus) ? bus : i2c;
+	b->cp_addr    = cp_addr;
+	b->dp_lo_addr = dp_lo_addr;
+	b->dp_hi_addr = dp_hi_addr;
+	b->async_failures = 0;
+#ifndef ARDUINO
+	if (NULL != b->bus) b->async_failures = b->bus->asyncFailures();
+#endif
+	b->router = new AudioRouter(cp_addr, dp_lo_addr, dp_hi_addr, b->bus);
+	b->router->deferLatch(true);    // sync() collects the latches.
+
+	// Whatever the board is already doing becomes part of the plan.
+	for (uint8_t i = 0; i < 8; i++) {
+		uint8_t row = b->router->getRoute(i);
+		plan.src[(board_count * 8) + i] = (row == AUDIO_ROUTER_UNBOUND) ? row : (board_count * 12) + row;
+	}
+	return board_count++;
+}
+
+
+uint8_t      RouterFabric::boardCount(void) {    return board_count;       }
+uint8_t      RouterFabric::inputCount(void) {    return board_count * 12;  }
+uint8_t      RouterFabric::outputCount(void) {   return board_count * 8;   }
+
+AudioRouter* RouterFabric::getBoard(uint8_t board) {
+	return (board < board_count) ? boards[board].router : NULL;
+}
+
+
+void RouterFabric::preserveOnDestroy(bool x) {
+	for (uint8_t i = 0; i < board_count; i++) boards[i].router->preserveOnDestroy(x);
+}
+
+
+/*
+* Once an output and input are linked, the fabric owns them. Anything that was routed
+*   to the output, or from the input, is disconnected. The link output is set to full
+*   scale so that the level is decided at the far end.
+*/
+int8_t RouterFabric::addLink(uint8_t out, uint8_t in) {
+	if (link_count >= ROUTER_FABRIC_MAX_LINKS) return ROUTER_FABRIC_ERROR_FULL;
+	if (out >= outputCount())   return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (in >= inputCount())     return AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW;
+	if ((out / 8) == (in / 12)) return ROUTER_FABRIC_ERROR_NO_PATH;   // A board linked to itself gains nothing.
+	if (isLinked(out, in))      return ROUTER_FABRIC_ERROR_LINKED;
+
+	release(&plan, out);
+	for (uint8_t o = 0; o < outputCount(); o++) {
+		if (plan.src[o] == in) release(&plan, o);
+	}
+	plan.links[link_count].out   = out;
+	plan.links[link_count].in    = in;
+	plan.links[link_count].src   = AUDIO_ROUTER_UNBOUND;
+	plan.links[link_count].users = 0;
+	link_count++;
+
+	boards[out / 8].router->setVolume(out % 8, 255);
+	return finish(apply());
+}
+
+
+uint8_t RouterFabric::linkCount(void) {
+	return link_count;
+}
+
+
+const FabricLink* RouterFabric::getLink(uint8_t link) {
+	return (link < link_count) ? &plan.links[link] : NULL;
+}
+
+
+const FabricBoard* RouterFabric::getBoardInfo(uint8_t board) {
+	return (board < board_count) ? &boards[board] : NULL;
+}
+
+
+bool RouterFabric::isLinked(uint8_t out, uint8_t in) {
+	for (uint8_t l = 0; l < link_count; l++) {
+		if ((plan.links[l].out == out) || (plan.links[l].in == in)) return true;
+	}
+	return false;
+}
+
+
+int8_t RouterFabric::link_from(uint8_t out) {
+	for (uint8_t l = 0; l < link_count; l++) {
+		if (plan.links[l].out == out) return l;
+	}
+	return -1;
+}
+
+
+/**************************************************************************
+* The route solver...                                                     *
+**************************************************************************/
+
+/*
+* Take a route out of the plan, freeing any links that nothing else is using.
+*/
+void RouterFabric::release(FabricPlan* p, uint8_t out) {
+	for (uint8_t i = 0; i < p->hops[out]; i++) {
+		FabricLink* k = &p->links[p->path[out][i]];
+		if (k->users > 0) k->users--;
+		if (k->users == 0) k->src = AUDIO_ROUTER_UNBOUND;
+	}
+	p->hops[out] = 0;
+	p->src[out]  = AUDIO_ROUTER_UNBOUND;
+}
+
+
+/*
+* Find the cheapest path from the input's board to the output's board, and add the
+*   route to the plan along it. A link that already carries this input costs almost
+*   nothing to share. An idle link costs a lot more. Links carrying anything else are
+*   impassable. There are few enough boards that Bellman-Ford is plenty.
+*/
+bool RouterFabric::assign(FabricPlan* p, uint8_t out, uint8_t src) {
+	uint8_t  from = src / 12;
+	uint8_t  to   = out / 8;
+	uint16_t cost[ROUTER_FABRIC_MAX_BOARDS];
+	int8_t   via[ROUTER_FABRIC_MAX_BOARDS];
+	for (uint8_t b = 0; b < board_count; b++) {
+		cost[b] = 0xFFFF;
+		via[b]  = -1;
+	}
+	cost[from] = 0;
+
+	for (uint8_t pass = 1; pass < board_count; pass++) {
+		for (uint8_t l = 0; l < link_count; l++) {
+			FabricLink* k = &p->links[l];
+			uint8_t a = k->out / 8;
+			uint8_t b = k->in / 12;
+			if (cost[a] == 0xFFFF) continue;
+			uint16_t weight;
+			if (k->src == src)     weight = 1;
+			else if (0 == k->users) weight = 16;
+			else                   continue;
+			if ((cost[a] + weight) < cost[b]) {
+				cost[b] = cost[a] + weight;
+				via[b]  = l;
+			}
+		}
+	}
+	if (cost[to] == 0xFFFF) return false;
+
+	uint8_t reversed[ROUTER_FABRIC_MAX_HOPS];
+	uint8_t hops = 0;
+	for (uint8_t b = to; b != from; b = p->links[via[b]].out / 8) {
+		if (hops >= ROUTER_FABRIC_MAX_HOPS) return false;
+		reversed[hops++] = via[b];
+	}
+	for (uint8_t i = 0; i < hops; i++) {
+		uint8_t l = reversed[hops - 1 - i];
+		p->path[out][i] = l;
+		p->links[l].src = src;
+		p->links[l].users++;
+	}
+	p->hops[out] = hops;
+	p->src[out]  = src;
+	return true;
+}
+
+
+/*
+* Route the input to the output in the given plan. If that is blocked, try moving
+*   each other cross-board route in turn to see if that makes room. At most one
+*   existing route is moved. Returns false (with the plan in an undefined state) if
+*   nothing worked.
+*/
+bool RouterFabric::solve(FabricPlan* p, uint8_t out, uint8_t src) {
+	release(p, out);
+	if (assign(p, out, src)) return true;
+
+	FabricPlan trial;
+	for (uint8_t o = 0; o < outputCount(); o++) {
+		if ((o == out) || (0 == p->hops[o])) continue;
+		memcpy(&trial, p, sizeof(trial));
+		uint8_t moved_src = trial.src[o];
+		release(&trial, o);
+		if (assign(&trial, out, src) && assign(&trial, o, moved_src)) {
+			memcpy(p, &trial, sizeof(trial));
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*
+* Which row on the given board has the given input on it? Either the input itself,
+*   or a link bringing it in from elsewhere.
+*/
+uint8_t RouterFabric::row_carrying(uint8_t src, uint8_t board) {
+	if ((src / 12) == board) return src % 12;
+	for (uint8_t l = 0; l < link_count; l++) {
+		if ((plan.links[l].src == src) && ((plan.links[l].in / 12) == board)) return plan.links[l].in % 12;
+	}
+	return AUDIO_ROUTER_UNBOUND;
+}
+
+
+/*
+* Make the boards agree with the plan. Every output is staged, and the boards' own
+*   batches work out which switches actually need to change.
+*/
+int8_t RouterFabric::apply(void) {
+	bool own_batch = !batch_open;
+	if (own_batch) begin();
+	for (uint8_t o = 0; o < outputCount(); o++) {
+		int8_t  l   = link_from(o);
+		uint8_t src = (l >= 0) ? plan.links[l].src : plan.src[o];
+		uint8_t row = (src == AUDIO_ROUTER_UNBOUND) ? src : row_carrying(src, o / 8);
+		if (row == AUDIO_ROUTER_UNBOUND) boards[o / 8].router->unroute(o % 8);
+		else                             boards[o / 8].router->route(o % 8, row);
+	}
+	return own_batch ? commit() : AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* Per-bus operations should only be done once for each bus, no matter how many boards
+*   are on it.
+*/
+bool RouterFabric::first_on_bus(uint8_t board) {
+	for (uint8_t i = 0; i < board; i++) {
+		if (boards[i].bus == boards[board].bus) return false;
+	}
+	return true;
+}
+
+
+#ifndef ARDUINO
+int8_t RouterFabric::startWorkers(uint8_t depth) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (first_on_bus(i) && (NULL != boards[i].bus) && !boards[i].bus->workerRunning()) {
+			if (boards[i].bus->startWorker(depth) != I2CAdapter::I2C_ADAPTER_ERROR_NO_ERROR) {
+				return ROUTER_FABRIC_ERROR_BUS;
+			}
+			own_workers = true;
+		}
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+void RouterFabric::stopWorkers(void) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (first_on_bus(i) && (NULL != boards[i].bus)) boards[i].bus->stopWorker();
+	}
+	own_workers = false;
+}
+#endif
+
+
+/*
+* Wait out every bus. Each board's switch latch is collected first, so a board whose
+*   latch failed has already been read back. Other writes handed to a bus worker don't
+*   report their failures to the caller, so we check whether any happened since the
+*   last time we looked. If they did, our idea of the boards on that bus can't be
+*   trusted. Those boards are read back, and the plan is rebuilt from what they are
+*   really doing. Writes that were lost will then be sent again by whatever asks for
+*   that state next.
+*/
+int8_t RouterFabric::sync(void) {
+	int8_t return_value = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (boards[i].router->settle() != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return_value = ROUTER_FABRIC_ERROR_BUS;
+	}
+#ifndef ARDUINO
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (first_on_bus(i) && (NULL != boards[i].bus)) {
+			boards[i].bus->drain();
+			uint32_t failures = boards[i].bus->asyncFailures();
+			if (failures != boards[i].async_failures) {
+				logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "%u deferred writes failed on the bus of board %u.", failures - boards[i].async_failures, i);
+				boards[i].async_failures = failures;
+				for (uint8_t j = i; j < board_count; j++) {
+					if (boards[j].bus == boards[i].bus) boards[j].router->refresh();
+				}
+				return_value = ROUTER_FABRIC_ERROR_BUS;
+			}
+		}
+	}
+#endif
+	if (return_value != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) resync();
+	return return_value;
+}
+
+
+/*
+* Outside of a batch, every operation waits for the buses before returning.
+*/
+int8_t RouterFabric::finish(int8_t result) {
+	if (batch_open) return result;
+	int8_t sync_result = sync();
+	return ((result >= 0) && (sync_result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR)) ? sync_result : result;
+}
+
+
+int8_t RouterFabric::route(uint8_t out, uint8_t in) {
+	if (out >= outputCount()) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (in >= inputCount())   return AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW;
+	if (isLinked(out, in))    return ROUTER_FABRIC_ERROR_LINKED;
+
+	int8_t return_value = ((plan.src[out] != AUDIO_ROUTER_UNBOUND) && (plan.src[out] != in)) ? AudioRouter::AUDIO_ROUTER_ERROR_INPUT_DISPLACED : AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	FabricPlan trial;
+	memcpy(&trial, &plan, sizeof(trial));
+	if (!solve(&trial, out, in)) return ROUTER_FABRIC_ERROR_NO_PATH;
+	memcpy(&plan, &trial, sizeof(plan));
+
+	int8_t result = finish(apply());
+	return (result == AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) ? return_value : result;
+}
+
+
+int8_t RouterFabric::unroute(uint8_t out) {
+	if (out >= outputCount()) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (link_from(out) >= 0)  return ROUTER_FABRIC_ERROR_LINKED;
+	release(&plan, out);
+	return finish(apply());
+}
+
+
+int8_t RouterFabric::unroute(uint8_t out, uint8_t in) {
+	if (out >= outputCount()) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (in >= inputCount())   return AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW;
+	if (plan.src[out] != in)  return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;   // They aren't connected.
+	return unroute(out);
+}
+
+
+int8_t RouterFabric::unrouteInput(uint8_t in) {
+	if (in >= inputCount())   return AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW;
+	if (isLinked(AUDIO_ROUTER_UNBOUND, in)) return ROUTER_FABRIC_ERROR_LINKED;
+	for (uint8_t o = 0; o < outputCount(); o++) {
+		if (plan.src[o] == in) release(&plan, o);
+	}
+	return finish(apply());
+}
+
+
+uint8_t RouterFabric::getRoute(uint8_t out) {
+	return (out < outputCount()) ? plan.src[out] : AUDIO_ROUTER_UNBOUND;
+}
+
+
+int8_t RouterFabric::setVolume(uint8_t out, uint8_t vol) {
+	if (out >= outputCount()) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (link_from(out) >= 0)  return ROUTER_FABRIC_ERROR_LINKED;
+	return finish(boards[out / 8].router->setVolume(out % 8, vol));
+}
+
+
+/*
+* Each board's writes are queued on its own bus before we wait for any of them.
+*   Link outputs stay at full scale.
+*/
+int8_t RouterFabric::setVolumeAll(uint8_t vol) {
+	int8_t return_value = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < board_count; i++) {
+		uint8_t vols[8];
+		for (uint8_t j = 0; j < 8; j++) vols[j] = (link_from((i * 8) + j) >= 0) ? 255 : vol;
+		int8_t result = boards[i].router->setVolumes(vols);
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return_value = result;
+	}
+	return finish(return_value);
+}
+
+
+int8_t RouterFabric::fadeTo(uint8_t out, uint8_t vol, uint32_t duration_ms, uint8_t curve) {
+	if (out >= outputCount()) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN;
+	if (link_from(out) >= 0)  return ROUTER_FABRIC_ERROR_LINKED;
+	return boards[out / 8].router->fadeTo(out % 8, vol, duration_ms, curve);
+}
+
+
+bool RouterFabric::fading(void) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (boards[i].router->fading()) return true;
+	}
+	return false;
+}
+
+
+int8_t RouterFabric::tick(void) {
+	int8_t return_value = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->tick();
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return_value = result;
+	}
+	return finish(return_value);
+}
+
+
+int8_t RouterFabric::begin(void) {
+	if (batch_open) return AudioRouter::AUDIO_ROUTER_ERROR_IN_BATCH;
+	for (uint8_t i = 0; i < board_count; i++) boards[i].router->begin();
+	memcpy(&batch_plan, &plan, sizeof(plan));
+	batch_open = true;
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* A board's commit only queues its latch, so every board commits before we wait on
+*   any bus, and boards on different buses latch together. finish() collects them. A
+*   board that fails to commit doesn't stop the others, but the plan no longer
+*   describes what the boards are doing. So it is rebuilt from them.
+*/
+int8_t RouterFabric::commit(void) {
+	if (!batch_open) return AudioRouter::AUDIO_ROUTER_ERROR_NO_BATCH;
+	batch_open = false;
+	int8_t return_value = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->commit();
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return_value = result;
+	}
+	if (return_value < 0) resync();
+	return finish(return_value);
+}
+
+
+int8_t RouterFabric::abort(void) {
+	if (!batch_open) return AudioRouter::AUDIO_ROUTER_ERROR_NO_BATCH;
+	batch_open = false;
+	for (uint8_t i = 0; i < board_count; i++) boards[i].router->abort();
+	memcpy(&plan, &batch_plan, sizeof(plan));
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+bool RouterFabric::inBatch(void) {
+	return batch_open;
+}
+
+
+int8_t RouterFabric::saveScene(uint8_t slot, const char* name) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->saveScene(slot, name);
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+/*
+* Each board moves straight to its scene, without the solver, so the plan has to be
+*   worked out again afterward from where the boards ended up.
+*/
+int8_t RouterFabric::recallScene(uint8_t slot) {
+	if (batch_open) return AudioRouter::AUDIO_ROUTER_ERROR_IN_BATCH;
+	for (uint8_t i = 0; i < board_count; i++) {
+		if (NULL == boards[i].router->getScene(slot)) return AudioRouter::AUDIO_ROUTER_ERROR_BAD_SCENE;
+	}
+	int8_t return_value = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->recallScene(slot);
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return_value = result;
+	}
+	resync();
+	return finish(return_value);
+}
+
+
+int8_t RouterFabric::findScene(const char* name) {
+	return (board_count > 0) ? boards[0].router->findScene(name) : AudioRouter::AUDIO_ROUTER_ERROR_BAD_SCENE;
+}
+
+
+/*
+* For every output that isn't a link, follow its input back through any links to
+*   the input that actually feeds it. A chain that ends on an unrouted link output
+*   carries nothing, and the output is taken to be unrouted.
+*/
+int8_t RouterFabric::resync(void) {
+	for (uint8_t l = 0; l < link_count; l++) {
+		plan.links[l].src   = AUDIO_ROUTER_UNBOUND;
+		plan.links[l].users = 0;
+	}
+	for (uint8_t o = 0; o < outputCount(); o++) {
+		plan.src[o]  = AUDIO_ROUTER_UNBOUND;
+		plan.hops[o] = 0;
+		if (link_from(o) >= 0) continue;
+
+		uint8_t reversed[ROUTER_FABRIC_MAX_HOPS];
+		uint8_t hops = 0;
+		uint8_t row  = boards[o / 8].router->getRoute(o % 8);
+		uint8_t src  = (row == AUDIO_ROUTER_UNBOUND) ? row : ((o / 8) * 12) + row;
+		while (src != AUDIO_ROUTER_UNBOUND) {
+			int8_t l = -1;
+			for (uint8_t k = 0; (k < link_count) && (l < 0); k++) {
+				if (plan.links[k].in == src) l = k;
+			}
+			if (l < 0) break;                 // An input from the outside world.
+			if (hops >= ROUTER_FABRIC_MAX_HOPS) {
+				src = AUDIO_ROUTER_UNBOUND;     // Going around in circles.
+				break;
+			}
+			reversed[hops++] = l;
+			uint8_t up = plan.links[l].out;
+			row = boards[up / 8].router->getRoute(up % 8);
+			src = (row == AUDIO_ROUTER_UNBOUND) ? row : ((up / 8) * 12) + row;
+		}
+		if (src == AUDIO_ROUTER_UNBOUND) continue;
+
+		for (uint8_t i = 0; i < hops; i++) {
+			uint8_t l = reversed[hops - 1 - i];
+			plan.path[o][i] = l;
+			plan.links[l].src = src;
+			plan.links[l].users++;
+		}
+		plan.hops[o] = hops;
+		plan.src[o]  = src;
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
+
+
+int8_t RouterFabric::enable(void) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->enable();
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) return result;
+	}
+	return finish(AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR);
+}
+
+
+int8_t RouterFabric::disable(void) {
+	for (uint8_t i = 0; i < board_count; i++) {
+		int8_t result = boards[i].router->disable();
+		if (result != AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR) {
+			resync();
+			return result;
+		}
+	}
+	resync();   // The boards have let go of every route, links included.
+	return finish(AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR);
+}
+
+
+int8_t RouterFabric::status(char* output, uint16_t len) {
+	if ((output == NULL) || (len == 0)) return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+	int n = 0;
+	output[0] = 0;
+	for (uint8_t i = 0; (i < board_count) && (n < len); i++) {
+		if (board_count > 1) {
+			n += snprintf(output + n, len - n, "==== Board %u (switch 0x%02x, pots 0x%02x/0x%02x). Inputs %u-%u, outputs %u-%u.\n",
+				i, boards[i].cp_addr, boards[i].dp_lo_addr, boards[i].dp_hi_addr, i * 12, (i * 12) + 11, i * 8, (i * 8) + 7);
+			if (n >= len) break;
+		}
+		boards[i].router->status(output + n, len - n);
+		n += strlen(output + n);
+	}
+	for (uint8_t l = 0; (l < link_count) && (n < len); l++) {
+		FabricLink* k = &plan.links[l];
+		n += snprintf(output + n, len - n, "Link %u: output %u (board %u) -> input %u (board %u). ", l, k->out, k->out / 8, k->in, k->in / 12);
+		if (n >= len) break;
+		if (0 == k->users) n += snprintf(output + n, len - n, "Idle.\n");
+		else               n += snprintf(output + n, len - n, "Carrying input %u for %u route(s).\n", k->src, k->users);
+	}
+	return AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+}
@@ -0,0 +1,170 @@
+/*
+File:   RouterFabric.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+This class presents several ViamSonus PCBs as one big router.
+
+Channels are numbered globally, in the order the boards were added. Board 0
+has inputs 0-11 and outputs 0-7, board 1 has inputs 12-23 and outputs 8-15,
+and so on. The boards may share a bus or each have their own.
+
+Where the buses have workers running (see startWorkers()), writes to different
+buses go out at the same time. So a change that spans the whole rack takes as
+long as the busiest bus, rather than the sum of all of them.
+
+Boards can also be cascaded. A link is an output of one board wired to an
+input of another. Linked channels belong to the fabric: they can't be routed
+directly, and link outputs are held at full scale. Routing an input to an
+output on another board finds a path through the links, preferring links that
+already carry the same input (fan-out costs nothing), then the fewest new
+links. If every path is blocked, one existing route may be moved to another
+path to make room. Whatever the solver decides is applied as one batch, so
+each board sees its switch changes under a single latch.
+*/
+
+
+#ifndef ROUTER_FABRIC_H
+#define ROUTER_FABRIC_H
+
+#include "AudioRouter.h"
+
+#define ROUTER_FABRIC_MAX_BOARDS   8
+#define ROUTER_FABRIC_MAX_LINKS    32
+#define ROUTER_FABRIC_MAX_INPUTS   (ROUTER_FABRIC_MAX_BOARDS * 12)
+#define ROUTER_FABRIC_MAX_OUTPUTS  (ROUTER_FABRIC_MAX_BOARDS * 8)
+#define ROUTER_FABRIC_MAX_HOPS     (ROUTER_FABRIC_MAX_BOARDS - 1)
+
+
+// This struct defines one PCB in the fabric.
+typedef struct fabric_board_t {
+  AudioRouter*  router;
+  I2CAdapter*   bus;
+  uint32_t      async_failures;  // The bus's failure count as of the last sync().
+  uint8_t       cp_addr;
+  uint8_t       dp_lo_addr;
+  uint8_t       dp_hi_addr;
+} FabricBoard;
+
+
+// This struct defines a wire from an output of one board to an input of another.
+typedef struct fabric_link_t {
+  uint8_t       out;             // Global output on the upstream board.
+  uint8_t       in;              // Global input on the downstream board.
+  uint8_t       src;             // Global input the link is carrying. AUDIO_ROUTER_UNBOUND if idle.
+  uint8_t       users;           // How many routes pass through the link.
+} FabricLink;
+
+
+// What the fabric intends to be connected. The hardware is made to agree with this.
+typedef struct fabric_plan_t {
+  FabricLink    links[ROUTER_FABRIC_MAX_LINKS];
+  uint8_t       src[ROUTER_FABRIC_MAX_OUTPUTS];     // Per global output, the global input feeding it.
+  uint8_t       path[ROUTER_FABRIC_MAX_OUTPUTS][ROUTER_FABRIC_MAX_HOPS];   // The links it goes through.
+  uint8_t       hops[ROUTER_FABRIC_MAX_OUTPUTS];
+} FabricPlan;
+
+
+class RouterFabric {
+  public:
+    RouterFabric(void);
+    ~RouterFabric(void);
+
+    int8_t addBoard(I2CAdapter* bus, uint8_t cp_addr, uint8_t dp_lo_addr, uint8_t dp_hi_addr);   // Returns the board's index, or an error.
+    uint8_t boardCount(void);
+    AudioRouter* getBoard(uint8_t board);
+    uint8_t inputCount(void);
+    uint8_t outputCount(void);
+    void preserveOnDestroy(bool);
+
+    int8_t addLink(uint8_t out, uint8_t in);   // Declare that a global output is wired to a global input.
+    uint8_t linkCount(void);
+    const FabricLink*  getLink(uint8_t link);     // NULL if there is no such link.
+    const FabricBoard* getBoardInfo(uint8_t board);
+    bool   isLinked(uint8_t out, uint8_t in);  // Is either channel part of a link? Pass AUDIO_ROUTER_UNBOUND to skip one.
+
+#ifndef ARDUINO
+    int8_t startWorkers(uint8_t depth);    // One bus thread per distinct bus.
+    void   stopWorkers(void);
+#endif
+    int8_t sync(void);                     // Wait for every bus to go idle. Re-reads boards whose writes failed.
+
+    int8_t route(uint8_t out, uint8_t in);
+    int8_t unroute(uint8_t out);
+    int8_t unroute(uint8_t out, uint8_t in);
+    int8_t unrouteInput(uint8_t in);
+    uint8_t getRoute(uint8_t out);         // The global input feeding the output. AUDIO_ROUTER_UNBOUND if none.
+
+    int8_t setVolume(uint8_t out, uint8_t vol);
+    int8_t setVolumeAll(uint8_t vol);
+    int8_t fadeTo(uint8_t out, uint8_t vol, uint32_t duration_ms, uint8_t curve = AudioRouter::AUDIO_ROUTER_CURVE_LINEAR);
+    bool   fading(void);
+    int8_t tick(void);
+
+    /*
+    * Batches open on every board at once, and commit on every board at once.
+    */
+    int8_t begin(void);
+    int8_t commit(void);
+    int8_t abort(void);
+    bool   inBatch(void);
+
+    /*
+    * Scenes are kept per board, and a slot means the same slot on every board. See
+    *   AudioRouter::saveScene(). Names are looked up on the first board.
+    */
+    int8_t saveScene(uint8_t slot, const char* name = NULL);
+    int8_t recallScene(uint8_t slot);
+    int8_t findScene(const char* name);
+    int8_t resync(void);                   // Rebuild the plan from what the boards are doing. After changing them directly.
+
+    int8_t enable(void);
+    int8_t disable(void);
+    int8_t status(char*, uint16_t len);    // Every board and link, into the buffer. Always terminated.
+
+    static constexpr const int8_t ROUTER_FABRIC_ERROR_FULL    = -20;   // No room for another board.
+    static constexpr const int8_t ROUTER_FABRIC_ERROR_NO_PATH = -21;   // There is no free path between the input and output.
+    static constexpr const int8_t ROUTER_FABRIC_ERROR_BUS     = -22;   // A deferred write failed on one of the buses.
+    static constexpr const int8_t ROUTER_FABRIC_ERROR_LINKED  = -23;   // The channel is part of a link, and belongs to the fabric.
+
+
+  private:
+    FabricBoard boards[ROUTER_FABRIC_MAX_BOARDS];
+    uint8_t     board_count;
+    uint8_t     link_count;
+    bool        batch_open;
+    bool        own_workers;
+    FabricPlan  plan;
+    FabricPlan  batch_plan;      // The plan as it was when the batch was opened, in case of abort().
+
+    bool   first_on_bus(uint8_t board);
+    int8_t finish(int8_t result);
+
+    int8_t  link_from(uint8_t out);
+    void    release(FabricPlan*, uint8_t out);
+    bool    assign(FabricPlan*, uint8_t out, uint8_t src);
+    bool    solve(FabricPlan*, uint8_t out, uint8_t src);
+    uint8_t row_carrying(uint8_t src, uint8_t board);
+    int8_t  apply(void);
+};
+
+#endif
@@ -0,0 +1,310 @@
+/*
+File:   RouterQueue.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "RouterQueue.h"
+#include <string.h>
+
+#ifndef ARDUINO
+  #include <time.h>
+  #include <errno.h>
+  #include "../Logger/Logger.h"
+  extern IansLogger logger;
+#endif
+
+#define ROUTER_QUEUE_TOUCHED_ROUTE   0x01
+#define ROUTER_QUEUE_TOUCHED_VOLUME  0x02
+
+
+RouterQueue::RouterQueue(RouterFabric* f, uint16_t depth) {
+	fabric = f;
+	uint32_t size = 2;
+	while (size < depth) size <<= 1;
+	mask  = size - 1;
+	cells = new RouterQueueCell[size];
+	for (uint32_t i = 0; i < size; i++) cells[i].seq = i;
+	enqueue_pos   = 0;
+	dequeue_pos   = 0;
+	dropped_count = 0;
+	failure_count = 0;
+	pass_count    = 0;
+	memset(touched, 0x00, sizeof(touched));
+#ifndef ARDUINO
+	sem_init(&wake, 0, 0);
+	owner_running = false;
+	owner_stop    = false;
+	wake_pending  = false;
+#endif
+}
+
+
+RouterQueue::~RouterQueue(void) {
+#ifndef ARDUINO
+	stop();
+	sem_destroy(&wake);
+#endif
+	delete[] cells;
+}
+
+
+/**************************************************************************
+* The producer side...                                                    *
+**************************************************************************/
+
+/*
+* A slot is free for the producer whose position matches its sequence number. The
+*   producers race for the position with a CAS, and the winner fills the slot and
+*   then hands it to the owner by bumping the sequence.
+*/
+bool RouterQueue::push(const RouterCommand* cmd) {
+	uint32_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	RouterQueueCell* cell;
+	for (;;) {
+		cell = &cells[pos & mask];
+		int32_t diff = (int32_t) (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+		if (0 == diff) {
+			if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		}
+		else if (diff < 0) {
+			__atomic_add_fetch(&dropped_count, 1, __ATOMIC_RELAXED);   // The owner hasn't got this far yet.
+			return false;
+		}
+		else {
+			pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+	cell->cmd = *cmd;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+#ifndef ARDUINO
+	if (!__atomic_exchange_n(&wake_pending, true, __ATOMIC_ACQ_REL)) sem_post(&wake);
+#endif
+	return true;
+}
+
+
+bool RouterQueue::route(uint8_t out, uint8_t in) {
+	RouterCommand cmd = { ROUTER_QUEUE_OP_ROUTE, out, in, 0 };
+	return push(&cmd);
+}
+
+
+bool RouterQueue::unroute(uint8_t out, uint8_t in) {
+	RouterCommand cmd = { ROUTER_QUEUE_OP_UNROUTE, out, in, 0 };
+	return push(&cmd);
+}
+
+
+bool RouterQueue::unrouteInput(uint8_t in) {
+	RouterCommand cmd = { ROUTER_QUEUE_OP_UNROUTE_IN, AUDIO_ROUTER_UNBOUND, in, 0 };
+	return push(&cmd);
+}
+
+
+bool RouterQueue::setVolume(uint8_t out, uint8_t vol) {
+	RouterCommand cmd = { ROUTER_QUEUE_OP_VOLUME, out, AUDIO_ROUTER_UNBOUND, vol };
+	return push(&cmd);
+}
+
+
+uint32_t RouterQueue::dropped(void) {
+	return __atomic_load_n(&dropped_count, __ATOMIC_RELAXED);
+}
+
+
+uint32_t RouterQueue::failures(void) {
+	return __atomic_load_n(&failure_count, __ATOMIC_RELAXED);
+}
+
+
+uint32_t RouterQueue::passes(void) {
+	return __atomic_load_n(&pass_count, __ATOMIC_RELAXED);
+}
+
+
+/**************************************************************************
+* The owner side...                                                       *
+**************************************************************************/
+
+bool RouterQueue::pop(RouterCommand* cmd) {
+	RouterQueueCell* cell = &cells[dequeue_pos & mask];
+	if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != (dequeue_pos + 1)) return false;
+	*cmd = cell->cmd;
+	__atomic_store_n(&cell->seq, dequeue_pos + mask + 1, __ATOMIC_RELEASE);   // Free for the next lap.
+	dequeue_pos++;
+	return true;
+}
+
+
+uint8_t RouterQueue::current(uint8_t out) {
+	return (touched[out] & ROUTER_QUEUE_TOUCHED_ROUTE) ? want_src[out] : fabric->getRoute(out);
+}
+
+
+/*
+* Unroutes are resolved against the merge as it stands, so a route pushed and then
+*   taken back in the same pass never reaches the bus.
+*/
+void RouterQueue::merge(const RouterCommand* cmd) {
+	uint8_t outputs = fabric->outputCount();
+	if ((cmd->op != ROUTER_QUEUE_OP_UNROUTE_IN) && (cmd->out >= outputs)) {
+		__atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	switch (cmd->op) {
+		case ROUTER_QUEUE_OP_ROUTE:
+			want_src[cmd->out] = cmd->in;
+			touched[cmd->out] |= ROUTER_QUEUE_TOUCHED_ROUTE;
+			break;
+		case ROUTER_QUEUE_OP_UNROUTE:
+			if ((cmd->in == AUDIO_ROUTER_UNBOUND) || (current(cmd->out) == cmd->in)) {
+				want_src[cmd->out] = AUDIO_ROUTER_UNBOUND;
+				touched[cmd->out] |= ROUTER_QUEUE_TOUCHED_ROUTE;
+			}
+			break;
+		case ROUTER_QUEUE_OP_UNROUTE_IN:
+			for (uint8_t o = 0; o < outputs; o++) {
+				if (current(o) == cmd->in) {
+					want_src[o] = AUDIO_ROUTER_UNBOUND;
+					touched[o] |= ROUTER_QUEUE_TOUCHED_ROUTE;
+				}
+			}
+			break;
+		case ROUTER_QUEUE_OP_VOLUME:
+			want_vol[cmd->out] = cmd->vol;
+			touched[cmd->out] |= ROUTER_QUEUE_TOUCHED_VOLUME;
+			break;
+		default:
+			__atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+			break;
+	}
+}
+
+
+/*
+* Unroutes go first, so that the paths they free are there for the routes.
+*/
+void RouterQueue::apply(void) {
+	uint8_t outputs = fabric->outputCount();
+	bool batch = (AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR == fabric->begin());
+	int8_t result;
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		for (uint8_t o = 0; o < outputs; o++) {
+			if (0 == (touched[o] & ROUTER_QUEUE_TOUCHED_ROUTE)) continue;
+			if (want_src[o] == fabric->getRoute(o)) continue;
+			bool unrouting = (want_src[o] == AUDIO_ROUTER_UNBOUND);
+			if (unrouting != (0 == pass)) continue;
+			result = unrouting ? fabric->unroute(o) : fabric->route(o, want_src[o]);
+			if (result < 0) __atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+		}
+	}
+	for (uint8_t o = 0; o < outputs; o++) {
+		if (0 == (touched[o] & ROUTER_QUEUE_TOUCHED_VOLUME)) continue;
+		result = fabric->setVolume(o, want_vol[o]);
+		if (result < 0) __atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+	}
+	if (batch) {
+		result = fabric->commit();
+		if (result < 0) __atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+	}
+	memset(touched, 0x00, sizeof(touched));
+}
+
+
+/*
+* A pass takes at most one queue's worth, so producers that never let up can't hold
+*   a batch open forever.
+*/
+uint16_t RouterQueue::drain(void) {
+	RouterCommand cmd;
+	uint16_t taken = 0;
+	while ((taken <= mask) && pop(&cmd)) {
+		merge(&cmd);
+		taken++;
+	}
+	if (taken > 0) {
+		apply();
+		__atomic_add_fetch(&pass_count, 1, __ATOMIC_RELAXED);
+	}
+	return taken;
+}
+
+
+#ifndef ARDUINO
+/**************************************************************************
+* The owner thread...                                                     *
+**************************************************************************/
+
+int8_t RouterQueue::start(void) {
+	if (owner_running) return ROUTER_QUEUE_ERROR_NO_ERROR;
+	__atomic_store_n(&owner_stop, false, __ATOMIC_RELEASE);
+	if (0 != pthread_create(&owner_thread, NULL, owner_loop, this)) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to start the router owner thread.");
+		return ROUTER_QUEUE_ERROR_THREAD;
+	}
+	owner_running = true;
+	return ROUTER_QUEUE_ERROR_NO_ERROR;
+}
+
+
+void RouterQueue::stop(void) {
+	if (!owner_running) return;
+	__atomic_store_n(&owner_stop, true, __ATOMIC_RELEASE);
+	sem_post(&wake);
+	pthread_join(owner_thread, NULL);
+	owner_running = false;
+}
+
+
+bool RouterQueue::running(void) {
+	return owner_running;
+}
+
+
+/*
+* Sleeps until a producer posts, or the next ramp step is due. The pending flag is
+*   cleared before draining, so a push that lands mid-drain posts again.
+*/
+void* RouterQueue::owner_loop(void* arg) {
+	RouterQueue* q = (RouterQueue*) arg;
+	for (;;) {
+		uint32_t ms = q->fabric->fading() ? AUDIO_ROUTER_RAMP_PERIOD_MS : 1000;
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec  += ms / 1000;
+		deadline.tv_nsec += (ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while ((0 != sem_timedwait(&q->wake, &deadline)) && (EINTR == errno)) {}
+
+		(void) __atomic_exchange_n(&q->wake_pending, false, __ATOMIC_ACQ_REL);
+		while (q->drain() > 0) {}
+		if (q->fabric->fading()) q->fabric->tick();
+		if (__atomic_load_n(&q->owner_stop, __ATOMIC_ACQUIRE)) break;
+	}
+	while (q->drain() > 0) {}
+	return NULL;
+}
+#endif  // ARDUINO
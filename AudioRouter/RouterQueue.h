@@ -0,0 +1,140 @@
+/*
+File:   RouterQueue.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+A command queue in front of a RouterFabric, for programs with many threads
+that want to change routes and levels.
+
+Neither the fabric nor the drivers under it are safe to call from more than
+one thread. So exactly one thread (the owner) talks to the fabric, and every
+other thread hands it commands through this queue. Any number of threads may
+push at once. Pushing never takes a lock and never waits on the bus. If the
+queue is full, the push fails and is counted, rather than blocking.
+
+The owner drains the queue in passes. Within a pass, commands are merged per
+output before anything is written: the last volume wins, and a route ends up
+in whatever state the last command left it. Everything that survives the
+merge goes to the fabric as one batch.
+
+On linux, start() spawns an owner thread. Elsewhere (or if the caller would
+rather own the fabric itself), call drain() from the loop that owns it.
+While the owner thread runs, nothing else may call the fabric.
+*/
+
+
+#ifndef ROUTER_QUEUE_H
+#define ROUTER_QUEUE_H
+
+#include "RouterFabric.h"
+
+#ifndef ARDUINO
+  #include <pthread.h>
+  #include <semaphore.h>
+#endif
+
+#define ROUTER_QUEUE_OP_ROUTE        0x01
+#define ROUTER_QUEUE_OP_UNROUTE      0x02   // If in is AUDIO_ROUTER_UNBOUND, whatever feeds the output.
+#define ROUTER_QUEUE_OP_UNROUTE_IN   0x03   // Every output the input feeds.
+#define ROUTER_QUEUE_OP_VOLUME       0x04
+
+
+// This struct is one command, as a producer pushes it.
+typedef struct router_command_t {
+  uint8_t       op;
+  uint8_t       out;             // Global output.
+  uint8_t       in;              // Global input.
+  uint8_t       vol;
+} RouterCommand;
+
+
+// A slot in the ring. seq tells producers and the owner whose turn it is.
+typedef struct router_queue_cell_t {
+  uint32_t      seq;
+  RouterCommand cmd;
+} RouterQueueCell;
+
+
+class RouterQueue {
+  public:
+    RouterQueue(RouterFabric*, uint16_t depth);   // Depth is rounded up to a power of two. We do not take ownership.
+    ~RouterQueue(void);
+
+    /*
+    * The producer side. Safe from any thread. Returns false if the queue was full.
+    */
+    bool push(const RouterCommand*);
+    bool route(uint8_t out, uint8_t in);
+    bool unroute(uint8_t out, uint8_t in = AUDIO_ROUTER_UNBOUND);
+    bool unrouteInput(uint8_t in);
+    bool setVolume(uint8_t out, uint8_t vol);
+
+    uint32_t dropped(void);          // Pushes refused because the queue was full.
+    uint32_t failures(void);         // Merged commands the fabric refused.
+    uint32_t passes(void);           // Drain passes that found something to apply.
+
+    /*
+    * The owner side. Only the owner may call these.
+    */
+    uint16_t drain(void);            // Merge and apply what is queued. Returns the number of commands taken.
+
+#ifndef ARDUINO
+    int8_t start(void);              // Spawn the owner thread.
+    void   stop(void);               // Apply whatever is still queued, then join the owner thread.
+    bool   running(void);
+#endif
+
+    static constexpr const int8_t ROUTER_QUEUE_ERROR_NO_ERROR = 0;
+    static constexpr const int8_t ROUTER_QUEUE_ERROR_THREAD   = -50;   // The owner thread couldn't be started.
+
+
+  private:
+    RouterFabric*    fabric;
+    RouterQueueCell* cells;
+    uint32_t         mask;
+    uint32_t         enqueue_pos;    // Shared by every producer.
+    uint32_t         dequeue_pos;    // The owner's alone.
+    uint32_t         dropped_count;
+    uint32_t         failure_count;
+    uint32_t         pass_count;
+
+    uint8_t  want_src[ROUTER_FABRIC_MAX_OUTPUTS];   // The merge, as it stands.
+    uint8_t  want_vol[ROUTER_FABRIC_MAX_OUTPUTS];
+    uint8_t  touched[ROUTER_FABRIC_MAX_OUTPUTS];    // ROUTER_QUEUE_TOUCHED_* flags.
+
+    bool    pop(RouterCommand*);
+    void    merge(const RouterCommand*);
+    uint8_t current(uint8_t out);    // The route as the merge would leave it.
+    void    apply(void);
+
+#ifndef ARDUINO
+    pthread_t owner_thread;
+    sem_t     wake;                  // Posted by producers, so the owner needn't poll.
+    bool      owner_running;
+    bool      owner_stop;
+    bool      wake_pending;          // Set by the first producer since the owner last looked.
+
+    static void* owner_loop(void*);
+#endif
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+File:   StatePage.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef ARDUINO
+
+#include "StatePage.h"
+#include "../i2c-adapter/i2c-adapter.h"    // For millis().
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+
+StatePage::StatePage(void) {
+	page   = NULL;
+	writer = false;
+	page_name[0] = 0;
+}
+
+
+StatePage::~StatePage(void) {
+	close();
+}
+
+
+int8_t StatePage::create(const char* name) {
+	close();
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (0 != ftruncate(fd, sizeof(StatePageData)))) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to create the state page %s.", name);
+		if (fd >= 0) ::close(fd);
+		return STATE_PAGE_ERROR_IO;
+	}
+	void* m = mmap(NULL, sizeof(StatePageData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);    // The mapping holds its own reference.
+	if (MAP_FAILED == m) return STATE_PAGE_ERROR_IO;
+
+	page   = (StatePageData*) m;
+	writer = true;
+	strncpy(page_name, name, sizeof(page_name) - 1);
+	page_name[sizeof(page_name) - 1] = 0;
+	page->version    = STATE_PAGE_VERSION;
+	page->board_size = sizeof(StatePageBoard);
+	page->writer_pid = (uint32_t) getpid();
+	heartbeat();
+	__atomic_store_n(&page->magic, STATE_PAGE_MAGIC, __ATOMIC_RELEASE);   // Last, so a reader never sees half a header.
+	return STATE_PAGE_ERROR_NO_ERROR;
+}
+
+
+int8_t StatePage::attach(const char* name) {
+	close();
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) return STATE_PAGE_ERROR_IO;
+	struct stat st;
+	if ((0 != fstat(fd, &st)) || (st.st_size < (off_t) sizeof(StatePageData))) {
+		::close(fd);
+		return STATE_PAGE_ERROR_FORMAT;
+	}
+	void* m = mmap(NULL, sizeof(StatePageData), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (MAP_FAILED == m) return STATE_PAGE_ERROR_IO;
+
+	page = (StatePageData*) m;
+	if ((__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != STATE_PAGE_MAGIC) ||
+		(page->version != STATE_PAGE_VERSION) || (page->board_size != sizeof(StatePageBoard))) {
+		close();
+		return STATE_PAGE_ERROR_FORMAT;
+	}
+	return STATE_PAGE_ERROR_NO_ERROR;
+}
+
+
+/*
+* The writer takes the page down with it, so a new reader can't mistake it for live.
+*   Readers that already have it mapped keep what they had, and the heartbeat tells
+*   them it has gone quiet.
+*/
+void StatePage::close(void) {
+	if (NULL != page) munmap(page, sizeof(StatePageData));
+	if (writer && page_name[0]) shm_unlink(page_name);
+	page   = NULL;
+	writer = false;
+	page_name[0] = 0;
+}
+
+
+bool StatePage::isOpen(void) {
+	return (NULL != page);
+}
+
+
+void StatePage::heartbeat(void) {
+	if (writer) __atomic_store_n(&page->heartbeat, (uint32_t) millis(), __ATOMIC_RELEASE);
+}
+
+
+/*
+* Everything is gathered from snapshots, so this never touches the bus. If nothing a
+*   reader could see has changed, the page isn't touched either, and readers never
+*   have to retry on our account.
+*/
+bool StatePage::publish(RouterFabric* fabric) {
+	if (!writer) return false;
+	heartbeat();
+
+	StatePageBoard boards[ROUTER_FABRIC_MAX_BOARDS];
+	FabricLink     links[ROUTER_FABRIC_MAX_LINKS];
+	memset(boards, 0x00, sizeof(boards));
+	memset(links,  0x00, sizeof(links));
+	uint8_t board_count = fabric->boardCount();
+	uint8_t link_count  = fabric->linkCount();
+	for (uint8_t i = 0; i < board_count; i++) {
+		const FabricBoard* info = fabric->getBoardInfo(i);
+		boards[i].cp_addr    = info->cp_addr;
+		boards[i].dp_lo_addr = info->dp_lo_addr;
+		boards[i].dp_hi_addr = info->dp_hi_addr;
+		info->router->snapshot(&boards[i].snap);
+	}
+	for (uint8_t l = 0; l < link_count; l++) {
+		memcpy(&links[l], fabric->getLink(l), sizeof(FabricLink));
+	}
+	if ((page->board_count == board_count) && (page->link_count == link_count) &&
+		(0 == memcmp(page->boards, boards, sizeof(boards))) &&
+		(0 == memcmp(page->links, links, sizeof(links)))) {
+		return false;
+	}
+
+	__atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	page->board_count = board_count;
+	page->link_count  = link_count;
+	memcpy(page->boards, boards, sizeof(boards));
+	memcpy(page->links, links, sizeof(links));
+	page->generation++;
+	__atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+
+int8_t StatePage::read(StatePageData* out) {
+	if (NULL == page) return STATE_PAGE_ERROR_NOT_OPEN;
+	for (uint16_t tries = 0; tries < STATE_PAGE_READ_TRIES; tries++) {
+		uint32_t seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+		memcpy(out, page, sizeof(StatePageData));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (seq == __atomic_load_n(&page->seq, __ATOMIC_RELAXED)) return STATE_PAGE_ERROR_NO_ERROR;
+	}
+	return STATE_PAGE_ERROR_TORN;
+}
+
+
+bool StatePage::alive(const StatePageData* data) {
+	return ((uint32_t) ((uint32_t) millis() - data->heartbeat) < STATE_PAGE_STALE_MS);
+}
+
+
+/*
+* Laid out as RouterFabric::status() would have it.
+*/
+uint16_t StatePage::format(const StatePageData* data, char* buf, uint16_t len) {
+	if ((buf == NULL) || (len == 0)) return 0;
+	int n = 0;
+	buf[0] = 0;
+	for (uint8_t i = 0; (i < data->board_count) && (i < ROUTER_FABRIC_MAX_BOARDS) && (n < len); i++) {
+		const StatePageBoard* b = &data->boards[i];
+		if (data->board_count > 1) {
+			n += snprintf(buf + n, len - n, "==== Board %u (switch 0x%02x, pots 0x%02x/0x%02x). Inputs %u-%u, outputs %u-%u.\n",
+				i, b->cp_addr, b->dp_lo_addr, b->dp_hi_addr, i * 12, (i * 12) + 11, i * 8, (i * 8) + 7);
+			if (n >= len) break;
+		}
+		n += AudioRouter::formatSnapshot(&b->snap, buf + n, len - n);
+	}
+	for (uint8_t l = 0; (l < data->link_count) && (l < ROUTER_FABRIC_MAX_LINKS) && (n < len); l++) {
+		const FabricLink* k = &data->links[l];
+		n += snprintf(buf + n, len - n, "Link %u: output %u (board %u) -> input %u (board %u). ", l, k->out, k->out / 8, k->in, k->in / 12);
+		if (n >= len) break;
+		if (0 == k->users) n += snprintf(buf + n, len - n, "Idle.\n");
+		else               n += snprintf(buf + n, len - n, "Carrying input %u for %u route(s).\n", k->src, k->users);
+	}
+	return (n < len) ? n : (len - 1);
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,119 @@
+/*
+File:   StatePage.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+The state of a fabric, exported in POSIX shared memory.
+
+The process that owns the bus (the daemon) creates the page and publishes
+into it whenever anything changes. Any other process may map it and read the
+routes, levels, names and chip health of every board without a syscall and
+without a bus transaction.
+
+The page is guarded by a sequence number that is odd while the writer is in
+it. A reader copies the page out, and goes again if the sequence was odd or
+moved during the copy. The generation goes up by one for each state that
+differs from the last. The heartbeat is millis() as of the writer's last look
+around, which is at least once a second while it is alive. millis() is on
+the monotonic clock, so it means the same thing in every process.
+*/
+
+
+#ifndef ROUTER_STATE_PAGE_H
+#define ROUTER_STATE_PAGE_H
+
+#ifndef ARDUINO
+  #include "RouterFabric.h"
+
+  #define STATE_PAGE_DEFAULT_NAME   "/audioroute.state"
+  #define STATE_PAGE_MAGIC          0x50534156   // "VASP"
+  #define STATE_PAGE_VERSION        1
+  #define STATE_PAGE_STALE_MS       5000         // A heartbeat older than this means the writer is gone.
+  #define STATE_PAGE_READ_TRIES     1000         // Before a reader gives up on a page that is always mid-write.
+
+
+  // This struct is one board, as the page has it.
+  typedef struct state_page_board_t {
+    uint8_t       cp_addr;
+    uint8_t       dp_lo_addr;
+    uint8_t       dp_hi_addr;
+    uint8_t       reserved;
+    CPSnapshot    snap;
+  } StatePageBoard;
+
+
+  // This struct is the whole page. Everything after seq is guarded by it.
+  typedef struct state_page_data_t {
+    uint32_t      magic;
+    uint16_t      version;
+    uint16_t      board_size;       // sizeof(StatePageBoard), so a reader built differently can tell.
+    uint32_t      seq;              // Odd while the writer is in the page.
+    uint32_t      heartbeat;        // Outside the seqlock. Written on its own.
+    uint32_t      generation;
+    uint32_t      writer_pid;
+    uint8_t       board_count;
+    uint8_t       link_count;
+    uint8_t       reserved[2];
+    StatePageBoard boards[ROUTER_FABRIC_MAX_BOARDS];
+    FabricLink     links[ROUTER_FABRIC_MAX_LINKS];
+  } StatePageData;
+
+
+  class StatePage {
+    public:
+      StatePage(void);
+      ~StatePage(void);
+
+      /*
+      * The writer's side. create() replaces any page of the same name. close() removes it.
+      */
+      int8_t create(const char* name = STATE_PAGE_DEFAULT_NAME);
+      bool   publish(RouterFabric*);          // Returns true if the state had changed.
+      void   heartbeat(void);
+
+      /*
+      * The reader's side. attach() is the only call that costs a syscall.
+      */
+      int8_t attach(const char* name = STATE_PAGE_DEFAULT_NAME);
+      int8_t read(StatePageData*);            // Copies out a consistent page.
+      bool   alive(const StatePageData*);     // Has the writer been heard from lately?
+
+      void   close(void);
+      bool   isOpen(void);
+
+      static uint16_t format(const StatePageData*, char* buf, uint16_t len);
+
+      static constexpr const int8_t STATE_PAGE_ERROR_NO_ERROR = 0;
+      static constexpr const int8_t STATE_PAGE_ERROR_IO       = -60;   // Couldn't open or map the page.
+      static constexpr const int8_t STATE_PAGE_ERROR_FORMAT   = -61;   // The page isn't ours, or was made by a different build.
+      static constexpr const int8_t STATE_PAGE_ERROR_NOT_OPEN = -62;
+      static constexpr const int8_t STATE_PAGE_ERROR_TORN     = -63;   // The writer never finished. It probably died mid-publish.
+
+
+    private:
+      StatePageData* page;
+      bool           writer;
+      char           page_name[64];
+  };
+
+#endif  // ARDUINO
+#endif
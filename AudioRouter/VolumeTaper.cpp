@@ -0,0 +1,59 @@
+/*
+File:   VolumeTaper.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "VolumeTaper.h"
+
+
+/*
+* Breakpoints for a mixing-console fader law: the top quarter of travel covers
+*   the last 10 dB, and the bottom quarter goes from -40 dB down to nothing.
+*/
+extern constexpr TaperPoint taper_fader_points[] = {
+  {0,   -480},
+  {64,  -400},
+  {128, -200},
+  {192, -100},
+  {224,  -50},
+  {255,    0}
+};
+
+
+/*
+* Everything here is constexpr, so none of it costs anything at runtime. The
+*   static_asserts are spot-checks on the generated math.
+*/
+constexpr TaperTable<uint8_t, 256>                   taper_audio    = taper_build<uint8_t, 256, TaperAudio>();
+constexpr TaperTable<uint8_t, VOLUME_TAPER_DB_STEPS> taper_db_steps = taper_build<uint8_t, VOLUME_TAPER_DB_STEPS, TaperDbSteps>();
+constexpr TaperTable<int16_t, 256>                   taper_wiper_db = taper_build<int16_t, 256, TaperWiperDb>();
+constexpr TaperTable<uint8_t, 256>                   taper_fader    = TaperBreakpoints<taper_fader_points, 6>::table();
+
+static_assert(taper_db_steps[0]   == 255, "0 dB should be full scale.");
+static_assert(taper_db_steps[60]  == 128, "-6.0 dB should be about half scale.");
+static_assert(taper_db_steps[120] == 64,  "-12.0 dB should be about a quarter of full scale.");
+static_assert(taper_wiper_db[255] == 0,   "Full scale should be 0 dB.");
+static_assert(taper_wiper_db[128] == -60, "Half scale should be about -6.0 dB.");
+static_assert(taper_wiper_db[0]   == VOLUME_TAPER_MUTE_DB10, "A wiper of zero should be silence.");
+static_assert(taper_audio[255]    == 255, "The top of the fader should be full scale.");
+static_assert(taper_fader[192]    == 81,  "Three-quarters up a console fader should be -10 dB.");
@@ -0,0 +1,203 @@
+/*
+File:   VolumeTaper.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+Volume tapers for the ISL23345's linear wipers.
+
+The pots are wired as voltage dividers, so the gain of an output is simply
+wiper/255. Ears want that in dB. Rather than doing floating-point log math
+every time a fader moves, the conversions are done by the compiler, and what
+ships is a handful of lookup tables. The hot path is integer-only.
+
+Levels are carried as dB x 10 (int16_t), so -6.5 dB is -65. 0 dB is a wiper
+of 255. The pots can't amplify, so nothing above 0 dB is representable.
+
+The tables are built by constexpr functions, which means a custom curve can
+be had the same way. Declare an array of TaperPoints with external linkage,
+and instantiate TaperBreakpoints<points, count>::table(). See taper_fader in
+VolumeTaper.cpp.
+*/
+
+
+#ifndef VOLUME_TAPER_H
+#define VOLUME_TAPER_H
+
+#include <inttypes.h>
+
+#define VOLUME_TAPER_MUTE_DB10     (-32768)   // The dB x 10 reported for a wiper of zero.
+#define VOLUME_TAPER_FLOOR_DB10    (-480)     // About the smallest non-zero step the wiper has (1/255).
+#define VOLUME_TAPER_DB_STEPS      481        // 0.0 dB to -48.0 dB in 0.1 dB steps.
+
+
+/*
+* A table whose contents are fixed at compile-time.
+*/
+template <typename T, uint16_t N> struct TaperTable {
+  T v[N];
+  constexpr T operator[](uint16_t i) const {  return v[i];  }
+  constexpr uint16_t size(void) const {        return N;     }
+};
+
+
+/*
+* A point on a custom curve. Position is the 0-255 fader position, and the level
+*   at that position is in dB x 10. Points must be given in order of position,
+*   and should start at 0 and end at 255.
+*/
+typedef struct taper_point_t {
+  uint8_t pos;
+  int16_t db10;
+} TaperPoint;
+
+
+/**************************************************************************
+* Compile-time math. C++11 constexpr functions may only be a single return
+*   statement, which is why all of this is recursive.
+**************************************************************************/
+
+constexpr double taper_ln10 = 2.302585092994046;
+constexpr double taper_ln2  = 0.6931471805599453;
+
+// e^x by its Taylor series. Only well-behaved for modest positive x.
+constexpr double taper_exp_terms(double x, double term, uint8_t n) {
+  return ((n > 80) || ((term < 1e-17) && (term > -1e-17))) ? 0.0 : term + taper_exp_terms(x, term * x / n, n + 1);
+}
+
+constexpr double taper_exp(double x) {
+  return (x < 0.0) ? 1.0 / taper_exp_terms(-x, 1.0, 1) : taper_exp_terms(x, 1.0, 1);
+}
+
+// ln(x) = 2 * atanh(z), z = (x-1)/(x+1). Converges quickly once x is near 1.
+constexpr double taper_atanh_terms(double z2, double zp, uint8_t k) {
+  return (k > 40) ? 0.0 : (zp / (2 * k + 1)) + taper_atanh_terms(z2, zp * z2, k + 1);
+}
+
+constexpr double taper_ln_near_one(double z) {
+  return 2.0 * taper_atanh_terms(z * z, z, 0);
+}
+
+// Scale x into [0.5, 2) by powers of two first.
+constexpr double taper_ln(double x, int k = 0) {
+  return (x < 0.5) ? taper_ln(x * 2.0, k - 1) : ((x >= 2.0) ? taper_ln(x / 2.0, k + 1) : taper_ln_near_one((x - 1.0) / (x + 1.0)) + (k * taper_ln2));
+}
+
+constexpr int16_t taper_round(double x) {
+  return (int16_t) ((x < 0.0) ? (x - 0.5) : (x + 0.5));
+}
+
+constexpr uint8_t taper_clamp_wiper(int16_t x) {
+  return (uint8_t) ((x < 0) ? 0 : ((x > 255) ? 255 : x));
+}
+
+// The wiper that gives the closest gain to the given level.
+constexpr uint8_t taper_db10_to_wiper(int32_t db10) {
+  return (db10 <= VOLUME_TAPER_MUTE_DB10) ? 0 : taper_clamp_wiper(taper_round(255.0 * taper_exp((db10 / 200.0) * taper_ln10)));
+}
+
+// The level given by a wiper setting.
+constexpr int16_t taper_wiper_to_db10(uint8_t w) {
+  return (w == 0) ? VOLUME_TAPER_MUTE_DB10 : taper_round(200.0 * taper_ln(w / 255.0) / taper_ln10);
+}
+
+// Linear interpolation of level between custom breakpoints.
+constexpr int16_t taper_interp(const TaperPoint* p, uint8_t n, uint8_t pos) {
+  return ((n < 2) || (pos <= p[1].pos)) ?
+    ((p[1].pos == p[0].pos) ? p[1].db10 : (int16_t) (p[0].db10 + (((int32_t) (p[1].db10 - p[0].db10) * (pos - p[0].pos)) / (p[1].pos - p[0].pos)))) :
+    taper_interp(p + 1, n - 1, pos);
+}
+
+
+/**************************************************************************
+* Table generation. We need an index sequence to expand each table from, and
+*   C++11 doesn't have one, so here is a small one.
+**************************************************************************/
+
+template <uint16_t... I> struct TaperIndices {};
+
+template <uint16_t N, uint16_t... I> struct TaperIndexBuilder : TaperIndexBuilder<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct TaperIndexBuilder<0, I...> {
+  typedef TaperIndices<I...> type;
+};
+
+/*
+* Curve is anything with a static constexpr at(uint16_t) that returns T.
+*/
+template <typename T, typename Curve, uint16_t... I>
+constexpr TaperTable<T, sizeof...(I)> taper_build(TaperIndices<I...>) {
+  return TaperTable<T, sizeof...(I)> {{ Curve::at(I)... }};
+}
+
+template <typename T, uint16_t N, typename Curve>
+constexpr TaperTable<T, N> taper_build(void) {
+  return taper_build<T, Curve>(typename TaperIndexBuilder<N>::type());
+}
+
+
+// Fader position (0-255) to wiper. Equal steps in dB from the floor up to 0 dB.
+struct TaperAudio {
+  static constexpr uint8_t at(uint16_t pos) {
+    return (pos == 0) ? 0 : taper_db10_to_wiper(VOLUME_TAPER_FLOOR_DB10 - ((VOLUME_TAPER_FLOOR_DB10 * (int32_t) pos) / 255));
+  }
+};
+
+// Attenuation in 0.1 dB steps to wiper. Index 65 is -6.5 dB.
+struct TaperDbSteps {
+  static constexpr uint8_t at(uint16_t step) {  return taper_db10_to_wiper(-((int32_t) step));  }
+};
+
+// Wiper to dB x 10. The reverse of the above.
+struct TaperWiperDb {
+  static constexpr int16_t at(uint16_t w) {  return taper_wiper_to_db10((uint8_t) w);  }
+};
+
+// Fader position (0-255) to wiper, following a list of breakpoints.
+template <const TaperPoint* P, uint8_t N> struct TaperBreakpoints {
+  static constexpr uint8_t at(uint16_t pos) {
+    return (pos == 0) ? 0 : taper_db10_to_wiper(taper_interp(P, N, (uint8_t) pos));
+  }
+  static constexpr TaperTable<uint8_t, 256> table(void) {
+    return taper_build<uint8_t, 256, TaperBreakpoints<P, N> >();
+  }
+};
+
+
+/**************************************************************************
+* The tables themselves live in VolumeTaper.cpp.
+**************************************************************************/
+
+extern const TaperTable<uint8_t, 256>                   taper_audio;       // Fader position to wiper.
+extern const TaperTable<uint8_t, VOLUME_TAPER_DB_STEPS> taper_db_steps;    // -dB x 10 to wiper.
+extern const TaperTable<int16_t, 256>                   taper_wiper_db;    // Wiper to dB x 10.
+extern const TaperTable<uint8_t, 256>                   taper_fader;       // Console-style fader law.
+
+
+/*
+* Level (dB x 10) to wiper, by table. Anything below the floor is silence.
+*/
+inline uint8_t volume_taper_db10(int16_t db10) {
+  if (db10 >= 0) return 255;
+  if (db10 <= -VOLUME_TAPER_DB_STEPS) return 0;
+  return taper_db_steps[-db10];
+}
+
+#endif
@@ -24,6 +24,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include "ISL23345.h"
+#include <string.h>
+
 const int8_t ISL23345::ISL23345_ERROR_DEVICE_DISABLED  = 3;    // A caller tried to set a wiper while the device is disabled. This may work...
 const int8_t ISL23345::ISL23345_ERROR_PEGGED_MAX       = 2;    // There was no error, but a call to change a wiper setting pegged the wiper at its highest position.
 const int8_t ISL23345::ISL23345_ERROR_PEGGED_MIN       = 1;    // There was no error, but a call to change a wiper setting pegged the wiper at its lowest position.
@@ -54,13 +56,22 @@ extern I2CAdapter *i2c;
 
 
 /*
-* Constructor. Takes the i2c address of this device as sole argument.
+* Constructor. Takes the i2c address of this device, and optionally the bus it is on.
 */
-ISL23345::ISL23345(uint8_t i2c_addr) {
+ISL23345::ISL23345(uint8_t i2c_addr, I2CAdapter* adapter) {
 	I2C_ADDRESS = i2c_addr;
+	bus         = (NULL != adapter) ? adapter : i2c;
 	dev_enabled = false;
 	dev_init    = false;
 	preserve_state_on_destroy = false;
+	write_back     = false;
+	dirty_mask     = 0;
+	flush_interval = 0;
+	last_flush     = 0;
+	for (uint8_t i = 0; i < 4; i++) {
+		values[i]    = 0;
+		hw_values[i] = 0;
+	}
 	init();
 }
 
@@ -68,6 +79,7 @@ ISL23345::ISL23345(uint8_t i2c_addr) {
 * When we destroy the class instance, the hardware will be disabled.
 */
 ISL23345::~ISL23345(void) {
+	if (dirty_mask) flush();
 	if (!preserve_state_on_destroy) {
 		disable();
 	}
@@ -78,37 +90,56 @@ ISL23345::~ISL23345(void) {
 * Call to read the device and cause this class's state to reflect that of the device. 
 */
 int8_t ISL23345::init(void) {
-	if ((i2c == NULL) || (!i2c->busOnline())) {
+	if ((bus == NULL) || (!bus->busOnline())) {
 		dev_init = false;
 		return ISL23345::ISL23345_ERROR_BUS;
 	}
-	int8_t return_value = ISL23345::ISL23345_ERROR_NO_ERROR;
 
-	uint8_t result = i2c->read8(I2C_ADDRESS, 0x10);
-	if (!i2c->bus_error) {
-		// If no error, we take the read value to accurately reflect our enable-state.
-		dev_enabled = ((result & 0x40) > 0);
-		dev_init = true;
-	}
-	else {
-		return_value = ISL23345_ERROR_ABSENT;
+	// The ACR and the wipers aren't contiguous, so this is two reads. But they go out
+	//   together as one transaction.
+	uint8_t acr = 0;
+	uint8_t wipers[4];
+	I2CTransaction txn;
+	txn.addWrite8(I2C_ADDRESS, 0x10);
+	txn.addRead(I2C_ADDRESS, &acr, 1);
+	txn.addWrite8(I2C_ADDRESS, 0x00);
+	txn.addRead(I2C_ADDRESS, wipers, 4);
+	if (bus->transact(&txn) < 0) {
 		dev_init = false;
+		return ISL23345_ERROR_ABSENT;
 	}
-	
-	if (dev_init) {
-		for (uint8_t i = 0; i < 4; i++) {
-			result = i2c->read8(I2C_ADDRESS, i);
-			if (!i2c->bus_error) {
-				values[i] = result;
-			}
-			else {
-				dev_init = false;
-				return ISL23345_ERROR_ABSENT;
-			}
-		}
+
+	// If no error, we take the read value to accurately reflect our enable-state.
+	dev_enabled = ((acr & 0x40) > 0);
+	for (uint8_t i = 0; i < 4; i++) {
+		values[i]    = wipers[i];
+		hw_values[i] = wipers[i];
 	}
-	
-	return return_value;
+	dirty_mask = 0;
+	dev_init = true;
+	return ISL23345::ISL23345_ERROR_NO_ERROR;
+}
+
+
+/*
+* Read all four wipers back from the device. The part auto-increments its address
+*   pointer across the wiper registers, so this is a single read.
+* Wipers with unflushed changes keep them.
+*/
+int8_t ISL23345::refresh(void) {
+	if ((bus == NULL) || (!bus->busOnline())) {
+		return ISL23345::ISL23345_ERROR_BUS;
+	}
+	uint8_t wipers[4];
+	if (bus->readX(I2C_ADDRESS, 0x00, 4, wipers) < 0) {
+		return ISL23345_ERROR_ABSENT;
+	}
+	for (uint8_t i = 0; i < 4; i++) {
+		hw_values[i] = wipers[i];
+		if (!(dirty_mask & (1 << i))) values[i] = wipers[i];
+		mark(i);
+	}
+	return ISL23345::ISL23345_ERROR_NO_ERROR;
 }
 
 
@@ -123,11 +154,11 @@ void ISL23345::preserveOnDestroy(bool x) {
 * Enable the device. Reconnects Rh pins and restores the wiper settings.
 */
 int8_t ISL23345::enable() {
-	if (!i2c->busOnline()) {
+	if (!bus->busOnline()) {
 		return ISL23345::ISL23345_ERROR_BUS;
 	}
 	int8_t return_value = ISL23345::ISL23345_ERROR_NO_ERROR;
-	if (i2c->write8(I2C_ADDRESS, 0x10, 0x40) > 0) {
+	if (bus->write8(I2C_ADDRESS, 0x10, 0x40) > 0) {
 		dev_enabled = true;
 	}
 	else {
@@ -142,11 +173,11 @@ int8_t ISL23345::enable() {
 * Retains wiper settings.
 */
 int8_t ISL23345::disable() {
-	if (!i2c->busOnline()) {
+	if (!bus->busOnline()) {
 		return ISL23345::ISL23345_ERROR_BUS;
 	}
 	int8_t return_value = ISL23345::ISL23345_ERROR_NO_ERROR;
-	if (i2c->write8(I2C_ADDRESS, 0x10, 0x00) > 0) {
+	if (bus->write8(I2C_ADDRESS, 0x10, 0x00) > 0) {
 		dev_enabled = false;
 	}
 	else {
@@ -162,20 +193,116 @@ int8_t ISL23345::disable() {
 int8_t ISL23345::setValue(uint8_t pot, uint8_t val) {
 	if (pot > 3)    return ISL23345::ISL23345_ERROR_INVALID_POT;
 	if (!dev_init)  return ISL23345::ISL23345_ERROR_DEVICE_DISABLED;
-	if (!i2c->busOnline()) {
+	if (write_back) {
+		values[pot] = val;
+		mark(pot);
+		return ISL23345::ISL23345_ERROR_NO_ERROR;
+	}
+	if (!bus->busOnline()) {
 		return ISL23345::ISL23345_ERROR_BUS;
 	}
 
 	int8_t return_value = ISL23345::ISL23345_ERROR_NO_ERROR;
-	if (i2c->write8(I2C_ADDRESS, pot, val) <= 0) {
+	if (bus->write8(I2C_ADDRESS, pot, val) <= 0) {
 		return_value = ISL23345::ISL23345_ERROR_ABSENT;
 	}
+	else {
+		hw_values[pot] = val;
+	}
 	values[pot] = val;
+	mark(pot);
 	return return_value;
 }
 
 
 
+/*
+* Set all four wipers at once. As with refresh(), this relies on the part's address
+*   auto-increment, and costs a single write.
+*/
+int8_t ISL23345::setValues(const uint8_t vals[4]) {
+	if (!dev_init)  return ISL23345::ISL23345_ERROR_DEVICE_DISABLED;
+	if (write_back) {
+		for (uint8_t i = 0; i < 4; i++) {
+			values[i] = vals[i];
+			mark(i);
+		}
+		return ISL23345::ISL23345_ERROR_NO_ERROR;
+	}
+	if (!bus->busOnline()) {
+		return ISL23345::ISL23345_ERROR_BUS;
+	}
+
+	uint8_t buf[4];
+	memcpy(buf, vals, 4);
+	if (bus->writeX(I2C_ADDRESS, 0x00, 4, buf) <= 0) {
+		return ISL23345::ISL23345_ERROR_ABSENT;
+	}
+	memcpy(values, vals, 4);
+	memcpy(hw_values, vals, 4);
+	dirty_mask = 0;
+	return ISL23345::ISL23345_ERROR_NO_ERROR;
+}
+
+
+/*
+* A wiper is dirty if what we want differs from what the part has.
+*/
+void ISL23345::mark(uint8_t pot) {
+	if (values[pot] != hw_values[pot]) dirty_mask |= (1 << pot);
+	else                               dirty_mask &= ~(1 << pot);
+}
+
+
+void ISL23345::setWriteBack(bool enable, uint16_t flush_ms) {
+	if (!enable && dirty_mask) flush();
+	write_back     = enable;
+	flush_interval = flush_ms;
+	last_flush     = millis();
+}
+
+
+bool    ISL23345::writeBack(void) {  return write_back;  }
+uint8_t ISL23345::dirty(void) {      return dirty_mask;  }
+
+
+/*
+* Send every dirty wiper in one auto-increment burst. The burst spans the lowest to
+*   the highest dirty wiper, so any clean wipers between them are re-sent as they are.
+*/
+int8_t ISL23345::flush(void) {
+	last_flush = millis();
+	if (0 == dirty_mask) return ISL23345::ISL23345_ERROR_NO_ERROR;
+	if (!bus->busOnline()) {
+		return ISL23345::ISL23345_ERROR_BUS;
+	}
+
+	uint8_t first = 0;
+	uint8_t last  = 3;
+	while (!(dirty_mask & (1 << first))) first++;
+	while (!(dirty_mask & (1 << last)))  last--;
+
+	uint8_t buf[4];
+	uint8_t count = last - first + 1;
+	memcpy(buf, &values[first], count);
+	if (bus->writeX(I2C_ADDRESS, first, count, buf) <= 0) {
+		return ISL23345::ISL23345_ERROR_ABSENT;
+	}
+	memcpy(&hw_values[first], buf, count);
+	dirty_mask = 0;
+	return ISL23345::ISL23345_ERROR_NO_ERROR;
+}
+
+
+int8_t ISL23345::poll(void) {
+	if (write_back && (flush_interval > 0) && ((unsigned long) (millis() - last_flush) >= flush_interval)) {
+		return flush();
+	}
+	return ISL23345::ISL23345_ERROR_NO_ERROR;
+}
+
+
+
 uint8_t ISL23345::getValue(uint8_t pot) {
 	if (pot > 3) return ISL23345_ERROR_INVALID_POT;
 	return values[pot];
@@ -192,18 +319,13 @@ int8_t ISL23345::reset(void) {
 
 
 int8_t ISL23345::reset(uint8_t val) {
-	int8_t result = 0;
-	for (int i = 0; i < 4; i++) {
-		result = setValue(0, val);
-		if (result != ISL23345_ERROR_NO_ERROR) {
-			return result;
-		}
-	}
-	return ISL23345_ERROR_NO_ERROR;
+	uint8_t vals[4] = {val, val, val, val};
+	return setValues(vals);
 }
 
 
 bool     ISL23345::enabled(void) {     return dev_enabled;  }  // Trivial accessor.
+bool     ISL23345::initialized(void) { return dev_init;     }  // Trivial accessor.
 uint16_t ISL23345::getRange(void) {    return 0x00FF;       }  // Trivial. Returns the maximum vaule of any single potentiometer.
 
 
@@ -216,6 +338,9 @@ void ISL23345::dumpToLog(void) {
 	}
 	
 	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "0x%02x is%s enabled.", I2C_ADDRESS, ((dev_enabled) ? "" : " not"));
+	if (write_back) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Write-back mode (flush every %u ms). Dirty: 0x%02x", flush_interval, dirty_mask);
+	}
 	for (int i = 0; i < 4; i++) {
 		logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "  POT %d: 0x%02x", i, values[i]);
 	}
@@ -43,16 +43,34 @@ This is the class that represents an ISL23345 digital potentiometer.
 *
 *
 */
+class I2CAdapter;
+
 class ISL23345 {
   public:
-    ISL23345(uint8_t i2c_addr);
+    ISL23345(uint8_t i2c_addr, I2CAdapter* bus = NULL);   // If no bus is given, we use the global one.
     ~ISL23345(void);
     
     int8_t init(void);                            // Perform bus-related init tasks.
+    bool   initialized(void);                     // Did the last init() succeed?
     void preserveOnDestroy(bool);
     
     int8_t setValue(uint8_t pot, uint8_t val);    // Sets the value of the given pot.
+    int8_t setValues(const uint8_t vals[4]);      // Sets all four pots in a single bus write.
     uint8_t getValue(uint8_t pot);
+    int8_t refresh(void);                         // Re-read all four wipers in a single bus read.
+
+    /*
+    * Write-back mode. Wiper changes only update the shadow and mark the wiper dirty.
+    *   Nothing goes to the bus until flush(), which sends the latest value of every
+    *   dirty wiper in one burst. If a flush interval is given, poll() will flush on
+    *   that schedule. Changes that put a wiper back where the part already has it
+    *   cost nothing.
+    */
+    void   setWriteBack(bool enable, uint16_t flush_ms = 0);
+    bool   writeBack(void);
+    uint8_t dirty(void);                          // Bitmask of wipers with unflushed changes.
+    int8_t flush(void);                           // Send any dirty wipers to the part.
+    int8_t poll(void);                            // Flush if the interval has elapsed. Call often.
     int8_t reset(void);                           // Sets all volumes levels to zero.
     int8_t reset(uint8_t);                        // Sets all volumes levels to given.
     
@@ -79,10 +97,18 @@ class ISL23345 {
     
   private:
     uint8_t I2C_ADDRESS;
+    I2CAdapter* bus;
     bool    dev_init;
     bool    dev_enabled;
     bool    preserve_state_on_destroy;
+    bool    write_back;
+
+    uint8_t  values[4];                           // What the wipers ought to be.
+    uint8_t  hw_values[4];                        // What we last knew the part to hold.
+    uint8_t  dirty_mask;
+    uint16_t flush_interval;
+    unsigned long last_flush;                     // millis() at the last flush(). Same width as millis(), so it wraps the same way.
 
-    uint8_t values[4];
+    void mark(uint8_t pot);
 };
 #endif
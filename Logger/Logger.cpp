@@ -76,8 +76,9 @@ void IansLogger::unified_log(const char *fxn_name, int severity, const char *str
 #ifndef ARDUINO
     int log_disseminated    = 0;
     time_t seconds = time(NULL);
+    struct tm now;                 // gmtime() shares one buffer among all threads. Bus workers log too.
     char *time_str    = (char *) alloca(32);
-    strftime(time_str, 32, "%c", gmtime(&seconds));
+    strftime(time_str, 32, "%c", gmtime_r(&seconds, &now));
     if (log_to_syslog) {
         syslog(severity, "%s", log_arg);
         log_disseminated    = 1;
@@ -104,8 +105,9 @@ void IansLogger::unified_log(int severity, const char *str) {
 	}
 #ifndef ARDUINO
     time_t seconds = time(NULL);
+    struct tm now;                 // gmtime() shares one buffer among all threads. Bus workers log too.
     char *time_str    = (char *) alloca(32);
-    strftime(time_str, 32, "%c", gmtime(&seconds));
+    strftime(time_str, 32, "%c", gmtime_r(&seconds, &now));
     printf("%s:    %s\n", time_str, str);        // Log to stdout.
 #else
     Serial.print(String(severity, 10));
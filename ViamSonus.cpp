@@ -27,7 +27,15 @@ This is an example sketch that shows the basic operation of the analog router PC
 
 #include "Logger/Logger.h"
 #include "AudioRouter/AudioRouter.h"
+#include "AudioRouter/RouterFabric.h"
+#include "AudioRouter/PresetLibrary.h"
+#include "AudioRouter/RouterConsole.h"
+#include "AudioRouter/RouterDaemon.h"
+#include "AudioRouter/RouterQueue.h"
+#include "AudioRouter/StatePage.h"
 #include "i2c-adapter/i2c-adapter.h"
+#include "i2c-adapter/i2c-sim.h"
+#include "i2c-adapter/i2c-capture.h"
 
 #define VERSION_STRING  "0.0.1"
 #define HOST_BAUD_RATE  9600
@@ -40,6 +48,12 @@ const uint8_t POT_1_ADDR  = 0x51;
 
 I2CAdapter *i2c = NULL;
 AudioRouter *audio_router = NULL;
+RouterFabric *fabric = NULL;
+I2CSimTransport *i2c_sim[ROUTER_FABRIC_MAX_BOARDS];
+uint8_t i2c_sim_count = 0;
+I2CRecordTransport *i2c_record = NULL;
+I2CReplayTransport *i2c_replay = NULL;
+RouterDaemon *daemon_instance = NULL;
 
 
 extern IansLogger logger;
@@ -120,10 +134,242 @@ void loop() {
 #include <termios.h>
 
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
 
 
 
 
+/*
+* A signal asks a running daemon to shut down cleanly.
+*/
+void onSignal(int sig) {
+	if (daemon_instance != NULL) daemon_instance->stop();
+}
+
+
+/*
+* Put the operation given on the command line into the daemon's words.
+*/
+bool buildCommand(char* buf, size_t len, char operation, uint8_t input_chan, uint8_t output_chan, uint8_t volume, int fade_ms, const char* preset_name) {
+	char out[8];
+	if (output_chan == 255) snprintf(out, sizeof(out), "all");
+	else                    snprintf(out, sizeof(out), "%u", output_chan);
+	switch (operation) {
+		case 'r':  snprintf(buf, len, "route %u %u", output_chan, input_chan);  break;
+		case 'u':
+			if (input_chan == 255)       snprintf(buf, len, "unroute %u", output_chan);
+			else if (output_chan == 255) snprintf(buf, len, "unroute-input %u", input_chan);
+			else                         snprintf(buf, len, "unroute %u %u", output_chan, input_chan);
+			break;
+		case 'v':
+			if (fade_ms > 0) snprintf(buf, len, "fade %s %u %d", out, volume, fade_ms);
+			else             snprintf(buf, len, "volume %s %u", out, volume);
+			break;
+		case 's':  snprintf(buf, len, "status");   break;
+		case 'e':  snprintf(buf, len, "enable");   break;
+		case 'd':  snprintf(buf, len, "disable");  break;
+		case 'x':  snprintf(buf, len, "reset");    break;
+		case 'p':  snprintf(buf, len, "preset %s", preset_name);       break;
+		case 'P':  snprintf(buf, len, "preset-save %s", preset_name);  break;
+		default:   return false;
+	}
+	return true;
+}
+
+
+/*
+* Is this one of the commands that only change routes and levels? Runs of those are
+*   gathered into one batch.
+*/
+bool coalescable(const char* cmd) {
+	const char* words[] = {"route", "unroute", "unroute-input", "volume", "mute"};
+	size_t len = strcspn(cmd, " \t\r\n");
+	for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		if ((strlen(words[i]) == len) && (0 == strncmp(cmd, words[i], len))) return true;
+	}
+	return false;
+}
+
+
+/*
+* Run a script of console commands, plus "sleep MS". Blank lines and lines starting
+*   with '#' are ignored. Consecutive route and level changes are committed together,
+*   so each board sees them as one latch and at most two writes per pot chip. Anything
+*   else commits what came before it first. Fades keep moving through sleeps, and the
+*   script doesn't end until they have finished. Returns how many lines failed.
+*/
+int runBatch(FILE* script, RouterFabric* fabric, RouterConsole* console) {
+	char line[ROUTER_DAEMON_LINE_LEN];
+	char reply[ROUTER_DAEMON_REPLY_LEN];
+	bool auto_batch = false;
+	int  failures   = 0;
+	int  line_no    = 0;
+	while (NULL != fgets(line, sizeof(line), script)) {
+		line_no++;
+		char* cmd = line + strspn(line, " \t");
+		if ((*cmd == '#') || (*cmd == '\r') || (*cmd == '\n') || (*cmd == 0)) continue;
+
+		bool gather = coalescable(cmd);
+		if (gather && !fabric->inBatch()) {
+			fabric->begin();
+			auto_batch = true;
+		}
+		else if (!gather && auto_batch) {
+			auto_batch = false;
+			int8_t result = fabric->commit();
+			if (result < 0) {
+				printf("Before line %d: %s\n", line_no, RouterConsole::resultString(result));
+				failures++;
+			}
+		}
+
+		if (0 == strncmp(cmd, "sleep", 5) && ((cmd[5] == ' ') || (cmd[5] == '\t'))) {
+			uint32_t until = millis() + strtoul(cmd + 6, NULL, 0);
+			while ((int32_t) (until - millis()) > 0) {
+				fabric->tick();
+				usleep(AUDIO_ROUTER_RAMP_PERIOD_MS * 1000);
+			}
+			continue;
+		}
+
+		int8_t result = console->execute(cmd, reply, sizeof(reply));
+		if (reply[0] != 0) printf("%s", reply);
+		if (result < 0) {
+			printf("Line %d: %s\n", line_no, RouterConsole::resultString(result));
+			failures++;
+		}
+	}
+	if (auto_batch) {
+		int8_t result = fabric->commit();
+		if (result < 0) {
+			printf("At the end: %s\n", RouterConsole::resultString(result));
+			failures++;
+		}
+	}
+	while (fabric->fading()) {
+		fabric->tick();
+		usleep(AUDIO_ROUTER_RAMP_PERIOD_MS * 1000);
+	}
+	return failures;
+}
+
+
+#define PRODUCER_COMMANDS   10000    // Pushed by each producer thread.
+#define PRODUCER_MAX        16
+
+// This struct is one producer thread's share of the queue exercise.
+typedef struct producer_t {
+  pthread_t    thread;
+  RouterQueue* queue;
+  uint8_t      id;
+  uint8_t      count;             // How many producers there are.
+  uint8_t      outputs;
+  const bool*  usable_out;        // Channels that aren't part of a link.
+  const bool*  usable_in;
+  uint32_t     retries;
+  uint8_t      want_src[ROUTER_FABRIC_MAX_OUTPUTS];   // What we last asked for.
+  uint8_t      want_vol[ROUTER_FABRIC_MAX_OUTPUTS];
+  bool         vol_set[ROUTER_FABRIC_MAX_OUTPUTS];
+} Producer;
+
+
+/*
+* Each producer owns every Nth output, so that the last thing pushed for an output
+*   is known, no matter how the threads interleave. Routes stay on the output's own
+*   board. A push that finds the queue full is retried until it goes in.
+*/
+void* producerLoop(void* arg) {
+	Producer* p = (Producer*) arg;
+	unsigned int seed = p->id + 1;
+	uint8_t mine[ROUTER_FABRIC_MAX_OUTPUTS];
+	uint8_t mine_count = 0;
+	for (uint8_t o = p->id; o < p->outputs; o += p->count) {
+		if (p->usable_out[o]) mine[mine_count++] = o;
+	}
+	for (uint32_t n = 0; (n < PRODUCER_COMMANDS) && (mine_count > 0); n++) {
+		uint8_t o    = mine[rand_r(&seed) % mine_count];
+		uint8_t in   = ((o / 8) * 12) + (rand_r(&seed) % 12);
+		uint8_t vol  = rand_r(&seed) & 0xFF;
+		int     dice = rand_r(&seed) % 10;
+		if ((dice < 5) && p->usable_in[in]) {
+			while (!p->queue->route(o, in)) { p->retries++; sched_yield(); }
+			p->want_src[o] = in;
+		}
+		else if (dice < 7) {
+			while (!p->queue->unroute(o)) { p->retries++; sched_yield(); }
+			p->want_src[o] = AUDIO_ROUTER_UNBOUND;
+		}
+		else {
+			while (!p->queue->setVolume(o, vol)) { p->retries++; sched_yield(); }
+			p->want_vol[o] = vol;
+			p->vol_set[o]  = true;
+		}
+	}
+	return NULL;
+}
+
+
+/*
+* Several threads push route and level changes at once, through a RouterQueue whose
+*   owner thread is the only thing touching the fabric. Afterward, every output must
+*   be in whatever state its producer last asked for. Returns how many aren't.
+*/
+int runProducers(RouterFabric* fabric, int count) {
+	bool usable_out[ROUTER_FABRIC_MAX_OUTPUTS];
+	bool usable_in[ROUTER_FABRIC_MAX_INPUTS];
+	for (uint8_t o = 0; o < fabric->outputCount(); o++) usable_out[o] = !fabric->isLinked(o, AUDIO_ROUTER_UNBOUND);
+	for (uint8_t i = 0; i < fabric->inputCount(); i++)  usable_in[i]  = !fabric->isLinked(AUDIO_ROUTER_UNBOUND, i);
+
+	// Once the owner is running, only it may look at the fabric.
+	RouterQueue queue(fabric, 64);
+	Producer producers[PRODUCER_MAX];
+	for (int t = 0; t < count; t++) {
+		Producer* p = &producers[t];
+		p->queue      = &queue;
+		p->id         = t;
+		p->count      = count;
+		p->outputs    = fabric->outputCount();
+		p->usable_out = usable_out;
+		p->usable_in  = usable_in;
+		p->retries    = 0;
+		for (uint8_t o = 0; o < p->outputs; o++) {
+			p->want_src[o] = fabric->getRoute(o);
+			p->vol_set[o]  = false;
+		}
+	}
+	if (queue.start() != RouterQueue::ROUTER_QUEUE_ERROR_NO_ERROR) {
+		printf("Couldn't start the queue's owner thread.\n");
+		return fabric->outputCount();
+	}
+	unsigned long t_start = millis();
+	for (int t = 0; t < count; t++) {
+		pthread_create(&producers[t].thread, NULL, producerLoop, &producers[t]);
+	}
+	uint32_t retries = 0;
+	for (int t = 0; t < count; t++) {
+		pthread_join(producers[t].thread, NULL);
+		retries += producers[t].retries;
+	}
+	queue.stop();
+	unsigned long elapsed = millis() - t_start;
+
+	int wrong = 0;
+	for (uint8_t o = 0; o < fabric->outputCount(); o++) {
+		if (!usable_out[o]) continue;
+		Producer* p = &producers[o % count];
+		bool ok = (fabric->getRoute(o) == p->want_src[o]);
+		if (p->vol_set[o]) ok = ok && (fabric->getBoard(o / 8)->getVolume(o % 8) == p->want_vol[o]);
+		if (!ok) wrong++;
+	}
+	printf("%d producers pushed %u commands in %lums. %u pushes found the queue full and were retried.\n",
+		count, (unsigned) (count * PRODUCER_COMMANDS), elapsed, (unsigned) retries);
+	printf("The owner applied them in %u passes. The fabric refused %u. %d output(s) ended up wrong.\n",
+		(unsigned) queue.passes(), (unsigned) queue.failures(), wrong);
+	return wrong + queue.failures();
+}
+
+
 /**
 * The help function. We use printf() because we are certain there is a user at the other end of STDOUT.
 */
@@ -132,8 +378,18 @@ void printUsage() {
 	printf("Bus and channel selection:\n");
 	printf("==================================================================================\n");
 	printf("    --i2c-dev     Specify the i2c device to use.\n");
-	printf("-i  --input       input pin (0-11)\n");
-	printf("-o  --output      output pin (0-7)\n");
+	printf("    --i2c-sim     Run against a simulated PCB with the given bus clock (kHz).\n");
+	printf("                   Prints what the bus traffic would have cost on exit.\n");
+	printf("    --record      Capture all bus traffic to the given file.\n");
+	printf("    --replay      Run against a capture file instead of a bus.\n");
+	printf("    --board       Add a PCB, given as bus:switch:pot0:pot1 (e.g. 1:0x76:0x50:0x51).\n");
+	printf("                   May be given up to %d times. Channels are then numbered across\n", ROUTER_FABRIC_MAX_BOARDS);
+	printf("                   all boards, in the order given: 12 inputs and 8 outputs apiece.\n");
+	printf("    --link        Declare that an output is wired to an input on another board,\n");
+	printf("                   given as output:input (e.g. 7:12). Routes between boards will\n");
+	printf("                   be found through the links. May be given up to %d times.\n", ROUTER_FABRIC_MAX_LINKS);
+	printf("-i  --input       input pin (0-11 for each board)\n");
+	printf("-o  --output      output pin (0-7 for each board)\n");
 	printf("\n");
 
 	printf("==================================================================================\n");
@@ -144,11 +400,41 @@ void printUsage() {
 	printf("                   is specified, we will unroute the given input from all outputs.\n");
 	printf("-v  --volume      Specify the value of the linear potentiometer (0-255).\n");
 	printf("                   If no output is specified, we will adjust all outputs.\n");
+	printf("    --fade        Ramp to the given volume over this many milliseconds.\n");
 	printf("-m  --mute        Mutes a specified output channel. If no output channel is\n");
 	printf("                   specified, we will mute all outputs. Note that muting an output\n");
 	printf("                   has no effect on the route.\n");
 	printf("\n");
 
+	printf("==================================================================================\n");
+	printf("Presets (these apply to the first board):\n");
+	printf("==================================================================================\n");
+	printf("    --presets     The preset library file to use. Created if it doesn't exist.\n");
+	printf("    --preset      Recall the named preset. Only what differs is changed.\n");
+	printf("    --preset-save Save the present routes and levels as the named preset.\n");
+	printf("\n");
+
+	printf("==================================================================================\n");
+	printf("Scripts:\n");
+	printf("==================================================================================\n");
+	printf("    --batch       Run the commands in the given file (or - for stdin), one per\n");
+	printf("                   line. These are the daemon's commands, plus \"sleep MS\".\n");
+	printf("                   Runs of route and level changes go out together.\n");
+	printf("    --producers   Exercise the command queue: this many threads (up to %d) push\n", PRODUCER_MAX);
+	printf("                   route and level changes at once, and one owner thread applies\n");
+	printf("                   them. Reports the cost, and checks that nothing was lost.\n");
+	printf("\n");
+
+	printf("==================================================================================\n");
+	printf("Daemon:\n");
+	printf("==================================================================================\n");
+	printf("    --daemon      Stay running and take commands over a Unix-domain socket.\n");
+	printf("    --socket      The socket path (default %s). Without --daemon,\n", ROUTER_DAEMON_DEFAULT_SOCKET);
+	printf("                   the operation is sent to a running daemon instead of the bus.\n");
+	printf("    --state       The daemon's shared-memory state page (default %s).\n", STATE_PAGE_DEFAULT_NAME);
+	printf("                   While a daemon is running, --status reads this, not the bus.\n");
+	printf("\n");
+
 	printf("==================================================================================\n");
 	printf("Meta:\n");
 	printf("==================================================================================\n");
@@ -165,9 +451,26 @@ void printUsage() {
 
 int main(int argc, char *argv[]) {
 	char operation   = '.';     // No operation.
+	int  exit_status = 0;
 	uint8_t volume       = 128;
 	uint8_t input_chan   = 255;
 	uint8_t output_chan  = 255;
+	int   bus_id         = -1;
+	int   sim_khz        = 0;
+	char* record_path    = NULL;
+	char* replay_path    = NULL;
+	int   fade_ms        = 0;
+	int   board_bus[ROUTER_FABRIC_MAX_BOARDS];
+	int   board_addr[ROUTER_FABRIC_MAX_BOARDS][3];
+	int   board_count    = 0;
+	int   link_spec[ROUTER_FABRIC_MAX_LINKS][2];
+	int   link_count     = 0;
+	char* presets_path   = NULL;
+	char* preset_name    = NULL;
+	char* socket_path    = NULL;
+	char* batch_path     = NULL;
+	char* state_name     = NULL;
+	int   producer_count = 0;
 	
 	logger.setVerbosity(7);
 
@@ -185,8 +488,85 @@ int main(int argc, char *argv[]) {
 		}
 		else if (argc - i >= 2) {    // Compound arguments go in this case block...
 			if (strcasestr(argv[i], "--i2c-dev")) {
-				i2c = new I2CAdapter(atoi(argv[++i]));          // Fire up the i2c interface...
-				i2c->setDebug(true);
+				bus_id = atoi(argv[++i]);
+			}
+			else if (strcasestr(argv[i], "--i2c-sim")) {
+				sim_khz = atoi(argv[++i]);
+				if (sim_khz <= 0) {
+					printf("Simulated bus clock needs to be given in kHz (100 or 400, usually).\n");
+					exit(0);
+				}
+			}
+			else if (strcasestr(argv[i], "--record")) {
+				record_path = argv[++i];
+			}
+			else if (strcasestr(argv[i], "--replay")) {
+				replay_path = argv[++i];
+			}
+			else if (strcasestr(argv[i], "--board")) {
+				char* spec = argv[++i];
+				if (board_count >= ROUTER_FABRIC_MAX_BOARDS) {
+					printf("No more than %d boards, please.\n", ROUTER_FABRIC_MAX_BOARDS);
+					exit(0);
+				}
+				int* a = board_addr[board_count];
+				if (sscanf(spec, "%i:%i:%i:%i", &board_bus[board_count], &a[0], &a[1], &a[2]) != 4) {
+					printf("A board is given as bus:switch:pot0:pot1. Not %s.\n", spec);
+					exit(0);
+				}
+				board_count++;
+			}
+			else if (strcasestr(argv[i], "--link")) {
+				char* spec = argv[++i];
+				if (link_count >= ROUTER_FABRIC_MAX_LINKS) {
+					printf("No more than %d links, please.\n", ROUTER_FABRIC_MAX_LINKS);
+					exit(0);
+				}
+				if (sscanf(spec, "%i:%i", &link_spec[link_count][0], &link_spec[link_count][1]) != 2) {
+					printf("A link is given as output:input. Not %s.\n", spec);
+					exit(0);
+				}
+				link_count++;
+			}
+			else if (strcasestr(argv[i], "--batch")) {
+				batch_path = argv[++i];
+				operation = 'B';
+			}
+			else if (strcasestr(argv[i], "--producers")) {
+				producer_count = atoi(argv[++i]);
+				if ((producer_count < 1) || (producer_count > PRODUCER_MAX)) {
+					printf("Between 1 and %d producers, please.\n", PRODUCER_MAX);
+					exit(1);
+				}
+				operation = 'Q';
+			}
+			else if (strcasestr(argv[i], "--socket")) {
+				socket_path = argv[++i];
+			}
+			else if (strcasestr(argv[i], "--state")) {
+				state_name = argv[++i];
+			}
+			else if (strcasestr(argv[i], "--presets")) {
+				presets_path = argv[++i];
+			}
+			else if (strcasestr(argv[i], "--preset-save")) {
+				preset_name = argv[++i];
+				if (strlen(preset_name) >= PRESET_LIBRARY_NAME_LEN) {
+					printf("Preset names can be at most %d characters.\n", PRESET_LIBRARY_NAME_LEN - 1);
+					exit(0);
+				}
+				operation = 'P';
+			}
+			else if (strcasestr(argv[i], "--preset")) {
+				preset_name = argv[++i];
+				operation = 'p';
+			}
+			else if (strcasestr(argv[i], "--fade")) {
+				fade_ms = atoi(argv[++i]);
+				if (fade_ms < 0) {
+					printf("Fade time needs to be given in milliseconds.\n");
+					exit(0);
+				}
 			}
 			else if (strcasestr(argv[i], "--volume") || ((argv[i][0] == '-') && (argv[i][1] == 'v'))) {
 				int temp_vol = atoi(argv[++i]);
@@ -199,16 +579,16 @@ int main(int argc, char *argv[]) {
 			}
 			else if (strcasestr(argv[i], "--input") || ((argv[i][0] == '-') && (argv[i][1] == 'i'))) {
 				int temp = atoi(argv[++i]);
-				if ((temp > 11) || (temp < 0)) {
-					printf("Input channel must be between 0 and 11.\n");
+				if ((temp >= ROUTER_FABRIC_MAX_BOARDS * 12) || (temp < 0)) {
+					printf("Input channel must be between 0 and 11 (per board).\n");
 					exit(0);
 				}
 				input_chan = (uint8_t) temp;
 			}
 			else if (strcasestr(argv[i], "--output") || ((argv[i][0] == '-') && (argv[i][1] == 'o'))) {
 				int temp = atoi(argv[++i]);
-				if ((temp > 7) || (temp < 0)) {
-					printf("Output channel must be between 0 and 7.\n");
+				if ((temp >= ROUTER_FABRIC_MAX_BOARDS * 8) || (temp < 0)) {
+					printf("Output channel must be between 0 and 7 (per board).\n");
 					exit(0);
 				}
 				output_chan = (uint8_t) temp;
@@ -223,6 +603,9 @@ int main(int argc, char *argv[]) {
 		else if (strcasestr(argv[i], "--disable")) {
 			operation = 'd';
 		}
+		else if (strcasestr(argv[i], "--daemon")) {
+			operation = 'D';
+		}
 		else if (strcasestr(argv[i], "--reset")) {
 			operation = 'x';
 		}
@@ -244,54 +627,271 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	
+
+	if ((operation == 'Q') && (socket_path != NULL)) {
+		printf("The queue exercise runs against the bus, not a daemon. Leave out --socket.\n");
+		exit(1);
+	}
+
+	FILE* script = NULL;
+	if (operation == 'B') {
+		if (socket_path != NULL) {
+			printf("Scripts run against the bus, not a daemon. Leave out --socket.\n");
+			exit(1);
+		}
+		script = (0 == strcmp(batch_path, "-")) ? stdin : fopen(batch_path, "r");
+		if (script == NULL) {
+			printf("Couldn't open the script %s.\n", batch_path);
+			exit(1);
+		}
+	}
+
+	// If there is a daemon to talk to, it owns the bus. We only pass the operation along.
+	if ((socket_path != NULL) && (operation != 'D')) {
+		char command[ROUTER_DAEMON_LINE_LEN];
+		char reply[ROUTER_DAEMON_REPLY_LEN];
+		if (!buildCommand(command, sizeof(command), operation, input_chan, output_chan, volume, fade_ms, preset_name)) {
+			printf("Nothing to do.\n");
+			exit(0);
+		}
+		int8_t result = RouterDaemon::send(socket_path, command, reply, sizeof(reply));
+		if (result == RouterDaemon::ROUTER_DAEMON_ERROR_CONNECT) {
+			printf("No daemon is answering on %s.\n", socket_path);
+			exit(1);
+		}
+		printf("%s%s\n", reply, RouterConsole::resultString(result));
+		exit((result < 0) ? 1 : 0);
+	}
+
+	// A running daemon keeps its state in shared memory. If there is one, status costs
+	//   no bus traffic, and doesn't contend with the daemon for the bus.
+	if (operation == 's') {
+		StatePage page;
+		StatePageData data;
+		if ((page.attach((state_name != NULL) ? state_name : STATE_PAGE_DEFAULT_NAME) == StatePage::STATE_PAGE_ERROR_NO_ERROR) &&
+			(page.read(&data) == StatePage::STATE_PAGE_ERROR_NO_ERROR) && page.alive(&data)) {
+			char buf[8192];
+			StatePage::format(&data, buf, sizeof(buf));
+			printf("%sState page generation %u, from pid %u.\n", buf, (unsigned) data.generation, (unsigned) data.writer_pid);
+			exit(0);
+		}
+	}
+
+	// The preset is looked up before anything touches the bus.
+	PresetLibrary presets;
+	const PresetRecord* preset = NULL;
+	if (((operation == 'D') || (operation == 'B')) && (presets_path != NULL)) {
+		if (presets.open(presets_path) != PresetLibrary::PRESET_LIBRARY_ERROR_NO_ERROR) {
+			printf("Failed to open the preset library %s.\n", presets_path);
+			exit(1);
+		}
+	}
+	if ((operation == 'p') || (operation == 'P')) {
+		if (presets_path == NULL) {
+			printf("Presets need a library. Use --presets.\n");
+			exit(1);
+		}
+		if (presets.open(presets_path) != PresetLibrary::PRESET_LIBRARY_ERROR_NO_ERROR) {
+			printf("Failed to open the preset library %s.\n", presets_path);
+			exit(1);
+		}
+		if (operation == 'p') {
+			preset = presets.find(preset_name);
+			if (preset == NULL) {
+				printf("No preset named %s in %s.\n", preset_name, presets_path);
+				exit(1);
+			}
+		}
+	}
+
+
+	// Assemble the bus. The transport is either real, simulated, or a capture being
+	//   replayed. Any of them can be recorded.
+	I2CTransport *transport = NULL;
+	if (board_count > 0) {
+		if ((replay_path != NULL) || (record_path != NULL)) {
+			printf("Capture and replay only work with a single board.\n");
+			exit(1);
+		}
+	}
+	else if (replay_path != NULL) {
+		i2c_replay = new I2CReplayTransport(replay_path);
+		if (sim_khz > 0) i2c_replay->setClock(sim_khz * 1000);
+		transport = i2c_replay;
+	}
+	else if (sim_khz > 0) {
+		i2c_sim[0] = new I2CSimTransport(sim_khz * 1000);
+		i2c_sim[0]->attachADG2128(SWITCH_ADDR);
+		i2c_sim[0]->attachISL23345(POT_0_ADDR);
+		i2c_sim[0]->attachISL23345(POT_1_ADDR);
+		i2c_sim_count = 1;
+		transport = i2c_sim[0];
+	}
+	else if (bus_id >= 0) {
+		transport = new LinuxI2CTransport(bus_id);          // Fire up the i2c interface...
+	}
+
+	if ((transport != NULL) && (record_path != NULL)) {
+		i2c_record = new I2CRecordTransport(transport, record_path);
+		transport = i2c_record;
+	}
+	if (transport != NULL) {
+		i2c = new I2CAdapter(transport);
+		i2c->setDebug(true);
+	}
+
+	// With several boards, each distinct bus gets its own adapter (and its own simulated
+	//   PCB population, if we are simulating).
+	I2CAdapter* board_adapter[ROUTER_FABRIC_MAX_BOARDS];
+	int bus_count = 0;
+	for (int b = 0; b < board_count; b++) {
+		board_adapter[b] = NULL;
+		for (int j = 0; j < b; j++) {
+			if (board_bus[j] == board_bus[b]) {
+				board_adapter[b] = board_adapter[j];
+				if (sim_khz > 0) i2c_sim[b] = i2c_sim[j];
+			}
+		}
+		if (sim_khz > 0) {
+			if (board_adapter[b] == NULL) i2c_sim[i2c_sim_count++] = i2c_sim[b] = new I2CSimTransport(sim_khz * 1000);
+			i2c_sim[b]->attachADG2128(board_addr[b][0]);
+			i2c_sim[b]->attachISL23345(board_addr[b][1]);
+			i2c_sim[b]->attachISL23345(board_addr[b][2]);
+		}
+		if (board_adapter[b] == NULL) {
+			board_adapter[b] = new I2CAdapter((sim_khz > 0) ? (I2CTransport*) i2c_sim[b] : (I2CTransport*) new LinuxI2CTransport(board_bus[b]));
+			board_adapter[b]->setDebug(true);
+			bus_count++;
+		}
+	}
+	if (board_count > 0) i2c = board_adapter[0];
+
 	if ((i2c != NULL) && (i2c->busOnline())) {
-		audio_router = new AudioRouter(SWITCH_ADDR, POT_0_ADDR, POT_1_ADDR);
+		fabric = new RouterFabric();
+		if (board_count == 0) {
+			fabric->addBoard(i2c, SWITCH_ADDR, POT_0_ADDR, POT_1_ADDR);
+		}
+		for (int b = 0; b < board_count; b++) {
+			fabric->addBoard(board_adapter[b], board_addr[b][0], board_addr[b][1], board_addr[b][2]);
+		}
+		for (int l = 0; l < link_count; l++) {
+			if (fabric->addLink(link_spec[l][0], link_spec[l][1]) < 0) {
+				printf("Couldn't link output %d to input %d.\n", link_spec[l][0], link_spec[l][1]);
+			}
+		}
+		// Boards on different buses are driven in parallel.
+		if (bus_count > 1) {
+			fabric->startWorkers(I2C_WORKER_MAX_QUEUE);
+		}
+
 		// Since this program will do its job and exit immediately (taking the
 		//   state of the switch with it), we need to instruct the class to not
 		//   disable the hardware when the program exits.
-		audio_router->preserveOnDestroy(true);
+		fabric->preserveOnDestroy(true);
 		
 		int8_t result = 0;
-		char *temp_str;
+		int    failures = 0;
 		switch (operation) {
 			case 'r':
-				result = audio_router->route(output_chan, input_chan);
+				result = fabric->route(output_chan, input_chan);
 				break;
 			case 'u':
 				if (input_chan == 255) {
-					result = audio_router->unroute(output_chan);
+					result = fabric->unroute(output_chan);
+				}
+				else if (output_chan == 255) {
+					result = fabric->unrouteInput(input_chan);
 				}
 				else {
-					result = audio_router->unroute(output_chan, input_chan);
+					result = fabric->unroute(output_chan, input_chan);
 				}
 				break;
 			case 's':
-				temp_str = (char*) alloca(1024);
-				result = audio_router->status(temp_str);
-				printf("%s\n", temp_str);
+				{
+					char buf[8192];
+					result = fabric->status(buf, sizeof(buf));
+					printf("%s\n", buf);
+				}
 				break;
 			case 'e':
-				result = audio_router->enable();
+				result = fabric->enable();
 				break;
 			case 'd':
-				result = audio_router->disable();
+				result = fabric->disable();
 				break;
 			case 'v':
-				if (output_chan == 255) {
-					for (int i = 0; i < 8; i++) {
-						result = audio_router->setVolume(i, volume);
+				if (fade_ms > 0) {
+					for (int i = 0; i < fabric->outputCount(); i++) {
+						if ((output_chan == 255) || (output_chan == i)) {
+							fabric->fadeTo(i, volume, fade_ms, AudioRouter::AUDIO_ROUTER_CURVE_LOG);
+						}
+					}
+					while (fabric->fading() && (result >= 0)) {
+						result = fabric->tick();
+						usleep(1000);
 					}
 				}
+				else if (output_chan == 255) {
+					result = fabric->setVolumeAll(volume);
+				}
 				else {
-					result = audio_router->setVolume(output_chan, volume);
+					result = fabric->setVolume(output_chan, volume);
+				}
+				break;
+			case 'p':
+			case 'P':
+				{
+					char command[ROUTER_DAEMON_LINE_LEN];
+					buildCommand(command, sizeof(command), operation, input_chan, output_chan, volume, fade_ms, preset_name);
+					RouterConsole console(fabric);
+					console.setPresets(&presets);
+					result = console.execute(command, NULL, 0);
+				}
+				break;
+			case 'B':
+				{
+					RouterConsole console(fabric);
+					if (presets.isOpen()) console.setPresets(&presets);
+					failures = runBatch(script, fabric, &console);
+					if (script != stdin) fclose(script);
+					if (failures > 0) printf("%d line(s) failed.\n", failures);
+					result = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+				}
+				break;
+			case 'Q':
+				failures = runProducers(fabric, producer_count);
+				result = AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR;
+				break;
+			case 'D':
+				{
+					RouterConsole console(fabric);
+					if (presets.isOpen()) console.setPresets(&presets);
+					daemon_instance = new RouterDaemon(fabric, &console);
+					StatePage state_page;
+					if (state_page.create((state_name != NULL) ? state_name : STATE_PAGE_DEFAULT_NAME) == StatePage::STATE_PAGE_ERROR_NO_ERROR) {
+						daemon_instance->setStatePage(&state_page);
+					}
+					else {
+						printf("Couldn't create the state page. Carrying on without it.\n");
+					}
+					result = daemon_instance->listen((socket_path != NULL) ? socket_path : ROUTER_DAEMON_DEFAULT_SOCKET);
+					if (result == RouterDaemon::ROUTER_DAEMON_ERROR_NO_ERROR) {
+						signal(SIGINT, onSignal);
+						signal(SIGTERM, onSignal);
+						result = daemon_instance->serve();
+					}
+					else {
+						printf("Couldn't listen on the socket (%d).\n", result);
+					}
+					delete daemon_instance;
+					daemon_instance = NULL;
 				}
 				break;
 			case 'x':
 				//if (audio_router->enabled()) {
-					audio_router->disable();
+					fabric->disable();
 				//}
-				result = audio_router->enable();
+				result = fabric->enable();
 				break;
 			case '.':
 				// No operation selected.
@@ -303,32 +903,33 @@ int main(int argc, char *argv[]) {
 				break;
 		}
 		
-		switch (result) {
-			case AudioRouter::AUDIO_ROUTER_ERROR_NO_ERROR:
-				printf("Operation completed with success.\n");
-				break;
-			case AudioRouter::AUDIO_ROUTER_ERROR_INPUT_DISPLACED:
-				printf("Operation completed with success, but we displaced a previously established route.\n");
-				break;
-			case AudioRouter::AUDIO_ROUTER_ERROR_BAD_COLUMN:
-				printf("Error: Output channel is out of range.\n");
-				break;
-			case AudioRouter::AUDIO_ROUTER_ERROR_BAD_ROW:
-				printf("Error: Input channel is out of range.\n");
-				break;
-			case AudioRouter::AUDIO_ROUTER_ERROR_UNROUTE_FAILED:
-				printf("Error: Failed to unroute the given channels.\n");
-				break;
-			default:
-				printf("Unhandled case: (%d).\n", result);
-				break;
+		// Failures were reported as they happened. Scripts that call us need to be
+		//   told through the exit status, the same as a daemon client would be.
+		if (failures > 0) {
+			exit_status = 1;
+		}
+		else {
+			printf("%s\n", RouterConsole::resultString(result));
+			exit_status = (result < 0) ? 1 : 0;
+		}
+
+		delete fabric;
+		for (int j = 0; j < i2c_sim_count; j++) {
+			i2c_sim[j]->dumpToLog();
+		}
+		if (i2c_replay != NULL) {
+			i2c_replay->dumpToLog();
+		}
+		if (i2c_record != NULL) {
+			i2c_record->flush();
 		}
 	}
 	else {
 		printf("You need to supply a valid i2c device.\n");
+		exit_status = 1;
 	}
 	
-	exit(0);
+	exit(exit_status);
 }
 
 
@@ -3,23 +3,16 @@
 #ifdef ARDUINO
   // We are running on an Arduino-style micro of some stripe...
   #include "Arduino.h"
-  #ifndef I2C_T3_H
-    #include <i2c_t3.h>
-    #ifdef I2C_DEBUG
-      #include <rbuf.h> // linker fix
-    #endif
-  #endif
 #else
   // We are being compiled for a linux system.
   #include <stdlib.h>
+  #include <string.h>
   #include <unistd.h>
-  #include <linux/i2c-dev.h>
-  #include <sys/ioctl.h>
   #include <sys/types.h>
-  #include <sys/stat.h>
   #include <stdint.h>
   #include <inttypes.h>
   #include <ctype.h>
+  #include <time.h>
 
   #include "../Logger/Logger.h"
   // Also, let's extern our logging functions...
@@ -30,52 +23,92 @@
 using namespace std;
 
 
+const int8_t I2CAdapter::I2C_ADAPTER_ERROR_NO_ERROR   = 0;
+const int8_t I2CAdapter::I2C_ADAPTER_ERROR_QUEUE_FULL = -1;
+const int8_t I2CAdapter::I2C_ADAPTER_ERROR_NO_WORKER  = -2;
+
+
+#ifndef ARDUINO
+/*
+* Monotonic, like their Arduino namesakes. They start counting at some arbitrary
+*   point, and wrap the same way.
+*/
+unsigned long millis(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long) ((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+unsigned long micros(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long) ((ts.tv_sec * 1000000) + (ts.tv_nsec / 1000));
+}
+#endif
+
+
 /**************************************************************************
 * Constructors / Destructors                                              *
 **************************************************************************/
 
 #ifdef ARDUINO
 I2CAdapter::I2CAdapter() {
-  // Init i2c...
-  Wire.begin(I2C_MASTER, 0x00, I2C_PINS_18_19, I2C_PULLUP_EXT, I2C_RATE_400);
-  bus_online = true;
-  bus_in_use = false;
-  bus_error = false;
+  init_state();
+  transport     = new WireI2CTransport();
+  own_transport = true;
 }
 #else
 
 I2CAdapter::I2CAdapter(uint8_t dev_id) {
-  bus_online = false;
-  bus_in_use = false;
-  bus_error  = false;
-  debug      = false;
-  open_bus_descriptor = -1;
-
-  char *filename = (char *) alloca(24);
-  if (sprintf(filename, "/dev/i2c-%d", dev_id) > 0) {
-      open_bus_descriptor = open(filename, O_RDWR);
-      if (open_bus_descriptor >= 0) {
-          bus_online = true;
-      }
-      else {
-          logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to open the i2c bus represented by %s.", filename);
-      }
-  }
-  else {
-      logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Somehow we failed to sprintf and build a filename to open i2c bus %d.", dev_id);
-  }
+  init_state();
+  transport     = new LinuxI2CTransport(dev_id);
+  own_transport = true;
 }
 #endif
 
 
+I2CAdapter::I2CAdapter(I2CTransport *xport) {
+  init_state();
+  transport     = xport;
+  own_transport = false;
+}
+
+
 I2CAdapter::~I2CAdapter() {
-    bus_online = false;
-    bus_in_use = false;
 #ifndef ARDUINO
-    if (open_bus_descriptor >= 0) {
-        logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Closing the open i2c bus...");
-        close(open_bus_descriptor);
+    stopWorker();
+#endif
+    bus_in_use = false;
+    if (own_transport && (NULL != transport)) {
+        delete transport;
     }
+    transport = NULL;
+#ifndef ARDUINO
+    pthread_cond_destroy(&queue_changed);
+    pthread_cond_destroy(&queue_nonempty);
+    pthread_mutex_destroy(&queue_mutex);
+    pthread_mutex_destroy(&bus_mutex);
+#endif
+}
+
+
+void I2CAdapter::init_state(void) {
+  bus_in_use = false;
+  bus_error  = false;
+  debug      = false;
+  transport     = NULL;
+  own_transport = false;
+#ifndef ARDUINO
+  worker_running = false;
+  worker_busy    = false;
+  queue_depth    = 0;
+  queue_head     = 0;
+  queue_count    = 0;
+  async_failures = 0;
+  pthread_mutex_init(&bus_mutex, NULL);
+  pthread_mutex_init(&queue_mutex, NULL);
+  pthread_cond_init(&queue_nonempty, NULL);
+  pthread_cond_init(&queue_changed, NULL);
 #endif
 }
 
@@ -86,12 +119,17 @@ I2CAdapter::~I2CAdapter() {
 **************************************************************************/
 
 bool I2CAdapter::busIdle(void) {
-    return (bus_online & !bus_in_use);
+    return (busOnline() && !__atomic_load_n(&bus_in_use, __ATOMIC_ACQUIRE));
+}
+
+
+bool I2CAdapter::busError(void) {
+    return __atomic_load_n(&bus_error, __ATOMIC_ACQUIRE);
 }
 
 
 bool I2CAdapter::busOnline(void) {
-    return bus_online;
+    return ((NULL != transport) && transport->busOnline());
 }
 
 
@@ -100,416 +138,302 @@ void I2CAdapter::setDebug(bool x) {
 }
 
 
-/*
-* Private function that will switch the addressed i2c device via ioctl. This
-*   function is meaningless on anything but a linux system, in which case it
-*   will always return true;
-* On a linux system, this will only return true if the ioctl call succeeded. 
-*/
-bool I2CAdapter::switch_device(uint8_t nu_addr) {
-    bool return_value = false;
-    unsigned short timeout = 10000;
-    if (nu_addr != last_used_bus_addr) {
-        if (!bus_online) {
-            // If the bus is either uninitiallized or not idle, decline
-            // to switch the device. Return false;
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "i2c bus is not online, so won't switch device. Failing....");
-            return return_value;
+#ifndef ARDUINO
+void I2CAdapter::log_transaction(I2CTransaction *txn) {
+    for (uint8_t n = 0; n < txn->seg_count; n++) {
+        I2CSegment *seg = &txn->segments[n];
+        char *temp = (char*) alloca((seg->len * 3) + 1);
+        memset(temp, 0x00, (seg->len * 3) + 1);
+        for (int i = 0; i < seg->len; i++) {
+            sprintf((temp+i*3), "%02x ", seg->buf[i]);
+        }
+        if (seg->flags & I2C_SEG_FLAG_READ) {
+            logger.unified_log(__PRETTY_FUNCTION__, LOG_DEBUG, "Read (%s) from %02x", temp, seg->dev_addr);
         }
         else {
-#ifdef ARDUINO
-            return_value = true;
-#else
-            while (bus_in_use && (timeout > 0)) { timeout--; }
-            if (bus_in_use) {
-                logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "i2c bus was held for too long. Failing....");
-                return return_value;
-            }
-            
-            if (ioctl(open_bus_descriptor, I2C_SLAVE, nu_addr) >= 0) {
-                last_used_bus_addr = nu_addr;
-                return_value = true;
-            }
-            else {
-                logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to acquire bus access and/or talk to slave at %d.", nu_addr);
-                bus_error = true;
-            }
-#endif
+            logger.unified_log(__PRETTY_FUNCTION__, LOG_DEBUG, "Wrote (%s) to %02x", temp, seg->dev_addr);
         }
     }
-    else {
-        return_value = true;
-    }
-    return return_value;
 }
+#endif
 
 
 /**************************************************************************
 * Functions that actually result in I/O on the bus...                     *
 **************************************************************************/
-#ifndef ARDUINO
 
-int I2CAdapter::writeX(uint8_t dev_addr, uint8_t sub_addr, uint16_t byte_count, uint8_t *buf) {
-    int return_value = -1;
-    uint8_t buffer[byte_count + 1];
-    buffer[0] = sub_addr;
-    
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, byte_count+1) == byte_count+1) {
-            bus_error = false;
-            return_value = 1;
-            if (debug) {
-            	char *temp = (char*) alloca(((byte_count+1)*3)+1);
-            	memset(temp, 0x00, ((byte_count+1)*3)+1);
-            	for (int i = 0; i < (byte_count+1)*3; i++) {
-            		sprintf((temp+i*3), "%02x ", buffer[i]);
-            	}
-            	logger.unified_log(__PRETTY_FUNCTION__, LOG_NOTICE, "Wrote (%s) to %02x", temp, dev_addr);
+/*
+* If the bus worker owns the bus, writes are handed to it and forgotten about. Any
+*   callback goes with them, and is how the caller can hear about the result later.
+*   The caller can't do anything with the result of a read until it has happened, so
+*   reads wait their turn in the queue. So do writes whose caller needs to know they
+*   landed. Their callback, if they have one, is kept too, and runs on the bus thread
+*   before we return.
+*/
+int I2CAdapter::transact(I2CTransaction *txn, bool wait) {
+#ifndef ARDUINO
+    if (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE) && !on_worker_thread()) {
+        if (wait || txn->hasReads()) {
+            txn->free_on_completion = false;
+            if (enqueue(txn) == I2C_ADAPTER_ERROR_NO_ERROR) {
+                int ret = await(txn);
+                __atomic_store_n(&bus_error, (ret < 0), __ATOMIC_RELEASE);
+                return ret;
             }
         }
         else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
+            I2CTransaction *nu = new I2CTransaction();
+            nu->copy(txn);
+            nu->callback     = txn->callback;
+            nu->callback_arg = txn->callback_arg;
+            nu->free_on_completion = true;
+            if (enqueue(nu) == I2C_ADAPTER_ERROR_NO_ERROR) {
+                txn->result = txn->seg_count;
+                return txn->result;
+            }
+            delete nu;
         }
-        bus_in_use = false;
+        // The worker was stopped before it took our transaction. Nothing is queued
+        //   ahead of us anymore, so it is safe to do it ourselves.
     }
-    return return_value;
+    pthread_mutex_lock(&bus_mutex);
+    int ret = execute(txn);
+    pthread_mutex_unlock(&bus_mutex);
+    return ret;
+#else
+    return execute(txn);
+#endif
 }
 
 
-int I2CAdapter::write8(uint8_t dev_addr, uint8_t dat) {
-    int return_value = -1;
-    uint8_t buffer[1];
-    buffer[0] = dat;
-    
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 1) == 1) {
-            bus_error = false;
-            return_value = 1;
-            if (debug) {
-            	char *temp = (char*) alloca(4);
-            	memset(temp, 0x00, 4);
-           		sprintf(temp, "%02x", buffer[0]);
-            	logger.unified_log(__PRETTY_FUNCTION__, LOG_NOTICE, "Wrote (%s) to %02x", temp, dev_addr);
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
+/*
+* The transport does the real work. We keep the book.
+*/
+int I2CAdapter::execute(I2CTransaction *txn) {
+    txn->result = -1;
+    if (!busOnline()) {
+#ifndef ARDUINO
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "i2c bus is not online. Failing....");
+#endif
+        __atomic_store_n(&bus_error, true, __ATOMIC_RELEASE);
+        return txn->result;
     }
-    return return_value;
+    if (txn->seg_count == 0) {
+        txn->result = 0;
+        return txn->result;
+    }
+    __atomic_store_n(&bus_in_use, true, __ATOMIC_RELEASE);
+    int ret = transport->execute(txn);
+    __atomic_store_n(&bus_in_use, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&bus_error, (ret != txn->seg_count), __ATOMIC_RELEASE);
+#ifndef ARDUINO
+    if (debug && (ret == txn->seg_count)) log_transaction(txn);
+#endif
+    return ret;
 }
 
 
-int I2CAdapter::write16(uint8_t dev_addr, uint16_t dat) {
-    int return_value = -1;
-    uint8_t buffer[2];
-    buffer[0] = (dat & 0xFF00) >> 8;
-    buffer[1] = dat & 0x00FF;
-    
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 2) == 2) {
-            bus_error = false;
-            return_value = 2;
-            if (debug) {
-            	char *temp = (char*) alloca(6);
-            	memset(temp, 0x00, 6);
-           		sprintf(temp, "%02x %02x", buffer[0], buffer[1]);
-            	logger.unified_log(__PRETTY_FUNCTION__, LOG_DEBUG, "Wrote (%s) to %02x", temp, dev_addr);
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
+#ifndef ARDUINO
+/**************************************************************************
+* The bus worker...                                                       *
+**************************************************************************/
+
+int8_t I2CAdapter::startWorker(uint8_t depth) {
+    if (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE)) return I2C_ADAPTER_ERROR_NO_ERROR;
+    queue_depth = ((depth == 0) || (depth > I2C_WORKER_MAX_QUEUE)) ? I2C_WORKER_MAX_QUEUE : depth;
+    queue_head  = 0;
+    queue_count = 0;
+    __atomic_store_n(&worker_running, true, __ATOMIC_RELEASE);
+    if (pthread_create(&worker_thread, NULL, I2CAdapter::worker_loop, (void*) this) != 0) {
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to start the bus worker.");
+        __atomic_store_n(&worker_running, false, __ATOMIC_RELEASE);
+        return I2C_ADAPTER_ERROR_NO_WORKER;
     }
-    return return_value;
+    return I2C_ADAPTER_ERROR_NO_ERROR;
 }
 
 
-int I2CAdapter::write8(uint8_t dev_addr, uint8_t sub_addr, uint8_t dat) {
-    int return_value = -1;
-    uint8_t buffer[4];
-    buffer[0] = sub_addr;
-    buffer[1] = dat;
-    
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 2) == 2) {
-            bus_error = false;
-            return_value = 1;
-            if (debug) {
-            	char *temp = (char*) alloca(6);
-            	memset(temp, 0x00, 6);
-           		sprintf(temp, "%02x %02x", buffer[0], buffer[1]);
-            	logger.unified_log(__PRETTY_FUNCTION__, LOG_DEBUG, "Wrote (%s) to %02x", temp, dev_addr);
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
-    }
-    return return_value;
+void I2CAdapter::stopWorker(void) {
+    if (!__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE)) return;
+    drain();
+    pthread_mutex_lock(&queue_mutex);
+    __atomic_store_n(&worker_running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&queue_nonempty);
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_mutex);
+    pthread_join(worker_thread, NULL);
 }
 
 
-/*
-  This function sends the MSB first.
-*/
-int I2CAdapter::write16(uint8_t dev_addr, uint8_t sub_addr, uint16_t dat) {
-    int return_value = -1;
-    uint8_t buffer[4];
-    buffer[0] = sub_addr;
-    buffer[1] = (dat & 0xFF00) >> 8;
-    buffer[2] = dat & 0x00FF;
-    
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 3) == 3) {
-            bus_error = false;
-            return_value = 2;
-            if (debug) {
-            	char *temp = (char*) alloca(9);
-            	memset(temp, 0x00, 9);
-           		sprintf(temp, "%02x %02x %02x", buffer[0], buffer[1], buffer[2]);
-            	logger.unified_log(__PRETTY_FUNCTION__, LOG_DEBUG, "Wrote (%s) to %02x", temp, dev_addr);
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
-    }
-    return return_value;
+bool I2CAdapter::workerRunning(void) {
+    return __atomic_load_n(&worker_running, __ATOMIC_ACQUIRE);
 }
 
 
+uint32_t I2CAdapter::asyncFailures(void) {
+    return __atomic_load_n(&async_failures, __ATOMIC_ACQUIRE);
+}
 
-uint8_t I2CAdapter::read8(uint8_t dev_addr, uint8_t sub_addr) {
-    uint8_t return_value = 0;
-    uint8_t buffer[4];
-    buffer[0] = sub_addr;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 1) == 1) {
-            if (read(open_bus_descriptor, buffer, 1)) {
-                return_value = buffer[0];
-                bus_error = false;
-            }
-            else {
-                printf("Failed to read the requested number of bytes from the i2c bus.");
-                bus_error = true;
-            }
-        }
-        else {
-            printf("Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
-    }
-    return return_value;
+
+bool I2CAdapter::on_worker_thread(void) {
+    return (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE) && pthread_equal(pthread_self(), worker_thread));
 }
 
 
-uint8_t I2CAdapter::read8(uint8_t dev_addr) {
-    uint8_t return_value = 0;
-    uint8_t buffer[1];
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 1) == 1) {
-            if (read(open_bus_descriptor, buffer, 1)) {
-                return_value = buffer[0];
-                bus_error = false;
-            }
-            else {
-                printf("Failed to read the requested number of bytes from the i2c bus.");
-                bus_error = true;
-            }
+/*
+* Never blocks. The transaction (and any read buffers it points at) must stay
+*   valid until it completes.
+*/
+int8_t I2CAdapter::submit(I2CTransaction *txn) {
+    int8_t return_value = I2C_ADAPTER_ERROR_NO_WORKER;
+    pthread_mutex_lock(&queue_mutex);
+    if (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE)) {
+        if (queue_count < queue_depth) {
+            txn->complete = false;
+            txn->result   = -1;
+            queue[(queue_head + queue_count) % queue_depth] = txn;
+            queue_count++;
+            pthread_cond_signal(&queue_nonempty);
+            return_value = I2C_ADAPTER_ERROR_NO_ERROR;
         }
         else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
+            return_value = I2C_ADAPTER_ERROR_QUEUE_FULL;
         }
-        bus_in_use = false;
     }
+    pthread_mutex_unlock(&queue_mutex);
     return return_value;
 }
 
 
 /*
-Returns MSB-first.
+* Like submit(), but waits for room rather than failing. Waiting and enqueueing
+*   happen under one hold of the lock, so another producer can't take the slot we
+*   waited for, and nothing we hand in can jump the queue.
+* Only fails if the worker stops.
 */
-uint16_t I2CAdapter::read16(uint8_t dev_addr, uint8_t sub_addr) {
-    uint16_t return_value = 0;
-    uint8_t buffer[2];
-    buffer[0] = sub_addr;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 1) == 1) {
-            if (read(open_bus_descriptor, buffer, 2)) {
-                return_value = (buffer[0] << 8) + buffer[1];
-                bus_error = false;
-            }
-            else {
-                logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to read the requested number of bytes from the i2c bus.");
-                bus_error = true;
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
+int8_t I2CAdapter::enqueue(I2CTransaction *txn) {
+    int8_t return_value = I2C_ADAPTER_ERROR_NO_WORKER;
+    pthread_mutex_lock(&queue_mutex);
+    while (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE) && (queue_count >= queue_depth)) {
+        pthread_cond_wait(&queue_changed, &queue_mutex);
+    }
+    if (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE)) {
+        txn->complete = false;
+        txn->result   = -1;
+        queue[(queue_head + queue_count) % queue_depth] = txn;
+        queue_count++;
+        pthread_cond_signal(&queue_nonempty);
+        return_value = I2C_ADAPTER_ERROR_NO_ERROR;
     }
+    pthread_mutex_unlock(&queue_mutex);
     return return_value;
 }
 
 
-uint16_t I2CAdapter::read16(uint8_t dev_addr, uint16_t sub_addr) {
-    uint16_t return_value = 0;
-    uint8_t buffer[2];
-    buffer[0] = (sub_addr >> 8) & 0xFF;
-    buffer[1] = (sub_addr) & 0xFF;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 2) == 2) {
-            if (read(open_bus_descriptor, buffer, 2)) {
-                return_value = (buffer[0] << 8) + buffer[1];
-                bus_error = false;
-            }
-            else {
-                logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to read the requested number of bytes from the i2c bus.");
-                bus_error = true;
-            }
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
+int I2CAdapter::await(I2CTransaction *txn) {
+    pthread_mutex_lock(&queue_mutex);
+    while (!txn->complete) {
+        pthread_cond_wait(&queue_changed, &queue_mutex);
     }
-    return return_value;
+    pthread_mutex_unlock(&queue_mutex);
+    return txn->result;
 }
 
 
-uint16_t I2CAdapter::read16(uint8_t dev_addr) {
-    uint16_t return_value = 0;
-    uint8_t buffer[2];
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (read(open_bus_descriptor, buffer, 2)) {
-            return_value = (buffer[0] << 8) + buffer[1];
-            bus_error = false;
-        }
-        else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to read the requested number of bytes from the i2c bus.");
-            bus_error = true;
-        }
-        bus_in_use = false;
+void I2CAdapter::drain(void) {
+    if (on_worker_thread()) return;
+    pthread_mutex_lock(&queue_mutex);
+    while (__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE) && ((queue_count > 0) || worker_busy)) {
+        pthread_cond_wait(&queue_changed, &queue_mutex);
     }
-    return return_value;
+    pthread_mutex_unlock(&queue_mutex);
 }
 
 
-int I2CAdapter::readX(uint8_t dev_addr, uint8_t sub_addr, uint8_t len, uint8_t *buf) {
-    int return_value = -1;
-    uint8_t buffer[1];
-    buffer[0] = sub_addr;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        if (write(open_bus_descriptor, buffer, 1) == 1) {
-            return_value = read(open_bus_descriptor, buf, len);
-            if (return_value == len) {
-                bus_error = false;
-            }
-            else {
-                logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to read the requested number of bytes from the i2c bus. Returned %d.", return_value);
-                bus_error = true;
-                return_value = -1;
-            }
+void* I2CAdapter::worker_loop(void *arg) {
+    I2CAdapter *self = (I2CAdapter*) arg;
+    while (true) {
+        pthread_mutex_lock(&self->queue_mutex);
+        while (__atomic_load_n(&self->worker_running, __ATOMIC_ACQUIRE) && (self->queue_count == 0)) {
+            pthread_cond_wait(&self->queue_nonempty, &self->queue_mutex);
+        }
+        if (self->queue_count == 0) {
+            // We were told to stop, and there is nothing left to do.
+            pthread_mutex_unlock(&self->queue_mutex);
+            break;
+        }
+        I2CTransaction *txn = self->queue[self->queue_head];
+        self->queue_head = (self->queue_head + 1) % self->queue_depth;
+        self->queue_count--;
+        self->worker_busy = true;
+        pthread_cond_broadcast(&self->queue_changed);    // A slot just opened up.
+        pthread_mutex_unlock(&self->queue_mutex);
+
+        pthread_mutex_lock(&self->bus_mutex);
+        int ret = self->execute(txn);
+        pthread_mutex_unlock(&self->bus_mutex);
+
+        if (NULL != txn->callback) txn->callback(txn, txn->callback_arg);
+
+        pthread_mutex_lock(&self->queue_mutex);
+        if (txn->free_on_completion) {
+            if (ret < 0) __atomic_add_fetch(&self->async_failures, 1, __ATOMIC_RELEASE);
+            delete txn;
         }
         else {
-            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to write a byte (reg address) to the i2c bus.");
-            bus_error = true;
+            txn->complete = true;
         }
-        bus_in_use = false;
+        self->worker_busy = false;
+        pthread_cond_broadcast(&self->queue_changed);
+        pthread_mutex_unlock(&self->queue_mutex);
     }
-    return return_value;
+    return NULL;
 }
+#endif
 
 
-#else
-
 int I2CAdapter::writeX(uint8_t dev_addr, uint8_t sub_addr, uint16_t byte_count, uint8_t *buf) {
     int return_value = -1;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        Wire.beginTransmission(dev_addr);
-        Wire.write(sub_addr);
-        for (int i=0; i<byte_count; i++) {
-            Wire.write(dat);
+    uint8_t buffer[byte_count + 1];
+    buffer[0] = sub_addr;
+    memcpy(&buffer[1], buf, byte_count);
+
+    I2CTransaction txn;
+    if (txn.addWrite(dev_addr, buffer, byte_count+1) == I2CTransaction::I2C_XFER_ERROR_NO_ERROR) {
+        if (transact(&txn) > 0) {
+            return_value = 1;
         }
-        Wire.endTransmission();
-        return_value = byte_count;
-        bus_in_use = false;
     }
+#ifndef ARDUINO
+    else {
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "%d bytes is too long for a single write.", byte_count);
+    }
+#endif
     return return_value;
 }
 
 
 int I2CAdapter::write8(uint8_t dev_addr, uint8_t dat) {
-    int return_value = -1;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        Wire.beginTransmission(dev_addr);
-        Wire.write(dat);
-        Wire.endTransmission();
-        bus_error = false;
-        return_value = 1;
-    }
-    return return_value;
+    I2CTransaction txn;
+    txn.addWrite8(dev_addr, dat);
+    return (transact(&txn) > 0) ? 1 : -1;
 }
 
 
-/*
-  This function sends the MSB first.
-*/
 int I2CAdapter::write16(uint8_t dev_addr, uint16_t dat) {
-    int return_value = -1;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        Wire.beginTransmission(dev_addr);
-        Wire.write((dat & 0xFF00) >> 8);
-        Wire.write(dat & 0xFF);
-        Wire.endTransmission();
-        bus_error = false;
-        return_value = 1;
-    }
-    return return_value;
+    I2CTransaction txn;
+    txn.addWrite16(dev_addr, dat);
+    return (transact(&txn) > 0) ? 2 : -1;
 }
 
 
 int I2CAdapter::write8(uint8_t dev_addr, uint8_t sub_addr, uint8_t dat) {
-    int return_value = -1;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        Wire.beginTransmission(dev_addr);
-        Wire.write(sub_addr);
-        Wire.write(dat);
-        Wire.endTransmission();
-        bus_error = false;
-        return_value = 1;
-    }
-    return return_value;
+    uint8_t buffer[2];
+    buffer[0] = sub_addr;
+    buffer[1] = dat;
+    I2CTransaction txn;
+    txn.addWrite(dev_addr, buffer, 2);
+    return (transact(&txn) > 0) ? 1 : -1;
 }
 
 
@@ -517,129 +441,71 @@ int I2CAdapter::write8(uint8_t dev_addr, uint8_t sub_addr, uint8_t dat) {
   This function sends the MSB first.
 */
 int I2CAdapter::write16(uint8_t dev_addr, uint8_t sub_addr, uint16_t dat) {
-    int return_value = -1;
-    if (switch_device(dev_addr)) {
-        bus_in_use = true;
-        Wire.beginTransmission(dev_addr);
-        Wire.write(sub_addr);
-        Wire.write((dat & 0xFF00) >> 8);
-        Wire.write(dat & 0xFF);
-        Wire.endTransmission();
-        bus_error = false;
-        return_value = 1;
-    }
-    return return_value;
+    uint8_t buffer[3];
+    buffer[0] = sub_addr;
+    buffer[1] = (dat & 0xFF00) >> 8;
+    buffer[2] = dat & 0x00FF;
+    I2CTransaction txn;
+    txn.addWrite(dev_addr, buffer, 3);
+    return (transact(&txn) > 0) ? 2 : -1;
 }
 
 
+
 uint8_t I2CAdapter::read8(uint8_t dev_addr, uint8_t sub_addr) {
-    uint8_t return_value = 0;
-    bus_in_use = true;
-
-    Wire.beginTransmission(dev_addr);
-    Wire.write(sub_addr);
-    Wire.endTransmission(I2C_NOSTOP);
-    Wire.requestFrom(dev_addr, 1, I2C_STOP);
-  
-    if (Wire.available() == 1) {
-        return_value = Wire.readByte();
-    }
-    else {
-      // Debug stuff goes here if needed.
-    }
-    bus_in_use = false;
-    return return_value;
+    uint8_t buffer[1] = {0};
+    I2CTransaction txn;
+    txn.addWrite8(dev_addr, sub_addr);
+    txn.addRead(dev_addr, buffer, 1);
+    transact(&txn);
+    return buffer[0];
 }
 
 
 uint8_t I2CAdapter::read8(uint8_t dev_addr) {
-    uint8_t return_value = 0;
-    bus_in_use = true;
-
-    Wire.beginTransmission(dev_addr);
-    Wire.requestFrom(dev_addr, 1, I2C_STOP);
-  
-    if (Wire.available() == 1) {
-      return_value = Wire.readByte();
-    }
-    else {
-      // Debug stuff goes here if needed.
-    }
-    bus_in_use = false;
-    return return_value;
+    uint8_t buffer[1] = {0};
+    I2CTransaction txn;
+    txn.addRead(dev_addr, buffer, 1);
+    transact(&txn);
+    return buffer[0];
 }
 
 
+/*
+Returns MSB-first.
+*/
 uint16_t I2CAdapter::read16(uint8_t dev_addr, uint8_t sub_addr) {
-    uint16_t return_value = 0;
-    bus_in_use = true;
-
-    Wire.beginTransmission(dev_addr);
-    Wire.write(sub_addr);
-    Wire.endTransmission(I2C_NOSTOP);
-    Wire.requestFrom(dev_addr, 2, I2C_STOP);
-  
-    if (Wire.available() == 2) {
-      return_value = (Wire.readByte() << 8) & 0xFF00;
-      return_value = return_value + Wire.readByte();
-    }
-    else {
-      // Debug stuff goes here if needed.
-    }
-    bus_in_use = false;
-    return return_value;
+    uint8_t buffer[2] = {0, 0};
+    I2CTransaction txn;
+    txn.addWrite8(dev_addr, sub_addr);
+    txn.addRead(dev_addr, buffer, 2);
+    transact(&txn);
+    return (buffer[0] << 8) + buffer[1];
 }
 
 
 uint16_t I2CAdapter::read16(uint8_t dev_addr, uint16_t sub_addr) {
-    uint16_t return_value = 0;
-    bus_in_use = true;
-
-    Wire.beginTransmission(dev_addr);
-    Wire.write(sub_addr);
-    Wire.endTransmission(I2C_NOSTOP);
-    Wire.requestFrom(dev_addr, 2, I2C_STOP);
-  
-    if (Wire.available() == 2) {
-      return_value = (Wire.readByte() << 8) & 0xFF00;
-      return_value = return_value + Wire.readByte();
-    }
-    else {
-      // Debug stuff goes here if needed.
-    }
-    bus_in_use = false;
-    return return_value;
+    uint8_t buffer[2] = {0, 0};
+    I2CTransaction txn;
+    txn.addWrite16(dev_addr, sub_addr);
+    txn.addRead(dev_addr, buffer, 2);
+    transact(&txn);
+    return (buffer[0] << 8) + buffer[1];
 }
 
 
-int I2CAdapter::readX(uint8_t dev_addr, uint8_t sub_addr, uint8_t len, uint8_t *buf) {
-    int return_value = -1;
-    uint8_t buffer[1];
-    buffer[0] = sub_addr;
-    bus_in_use = true;
-    Wire.beginTransmission(dev_addr);
-    Wire.write(sub_addr);
-    Wire.endTransmission(I2C_NOSTOP);
-    Wire.requestFrom(dev_addr, len, I2C_STOP);
-
-    if (Wire.available() == len) {
-      for (int i=0; i<len; i++) {
-            *(buf+i) = Wire.readByte();
-      }
-      return_value = len;
-    }
-    else {
-      // Debug stuff goes here if needed.
-    }
-
-    bus_in_use = false;
-    return return_value;
+uint16_t I2CAdapter::read16(uint8_t dev_addr) {
+    uint8_t buffer[2] = {0, 0};
+    I2CTransaction txn;
+    txn.addRead(dev_addr, buffer, 2);
+    transact(&txn);
+    return (buffer[0] << 8) + buffer[1];
 }
 
 
-#endif
-
-/**************************************************************************
-* Statics...                                                              *
-**************************************************************************/
-
+int I2CAdapter::readX(uint8_t dev_addr, uint8_t sub_addr, uint8_t len, uint8_t *buf) {
+    I2CTransaction txn;
+    txn.addWrite8(dev_addr, sub_addr);
+    txn.addRead(dev_addr, buf, len);
+    return (transact(&txn) > 0) ? len : -1;
+}
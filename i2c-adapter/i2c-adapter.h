@@ -43,23 +43,35 @@ but adding support for other platforms ought to be easy.
     #include <iostream>
     #include <sys/stat.h>
     #include <fcntl.h>
+    #include <pthread.h>
   #endif
 
+  #include "i2c-transport.h"
+
+  #define I2C_WORKER_MAX_QUEUE    64     // Upper bound on the bus worker's queue depth.
+
+#ifndef ARDUINO
+  // The Arduino environment gives drivers these. We give them the same on linux, so
+  //   that timing logic in the drivers needn't care where it runs.
+  unsigned long millis(void);
+  unsigned long micros(void);
+#endif
+
 
   class I2CAdapter {
 
     public:
-      bool bus_error;
-        
 #ifndef ARDUINO
       I2CAdapter(uint8_t);         // Constructor takes a bus ID as an argument. Useful on platforms that have several busses.
 #else
       I2CAdapter(void);            // Constructor takes an optional device ID (bus ID) as an argument.
 #endif
+      I2CAdapter(I2CTransport*);   // Run on top of the given transport. We do not take ownership of it.
       ~I2CAdapter(void);           // Destructor
 
       bool busIdle(void);          // Returns true if the bus is ready to service a transaction right now. 
       bool busOnline(void);
+      bool busError(void);         // True if the last transaction to finish failed. Safe from any thread.
       
       // Writes <byte_count> bytes from <buf> to the sub-address <sub_addr> of i2c device <dev_addr>.
       // Returns the number of bytes so written.
@@ -76,21 +88,64 @@ but adding support for other platforms ought to be easy.
       uint16_t read16(uint8_t dev_addr);
       uint16_t read16(uint8_t dev_addr, uint16_t sub_addr);
       int readX(uint8_t dev_addr, uint8_t sub_addr, uint8_t len, uint8_t *buf);
+
+      // Put every segment of the given transaction on the bus as one combined message.
+      // Returns the number of segments transferred, or -1 on failure.
+      // If the bus worker is running, transactions that only write are queued and this
+      //   returns immediately (optimistically). Transactions that read wait for their turn,
+      //   as do writes if <wait> is set, so that their result is real.
+      // Whatever the worker runs has its callback (if any) called from the bus thread.
+      int transact(I2CTransaction*, bool wait = false);
+
+#ifndef ARDUINO
+      // Asynchronous operation. A dedicated thread owns the bus and runs submitted
+      //   transactions in order. Nothing else touches the bus while it runs.
+      int8_t startWorker(uint8_t depth);   // Spawn the bus thread with a queue of the given depth.
+      void   stopWorker(void);             // Finish everything queued, then join the bus thread.
+      bool   workerRunning(void);
+      int8_t submit(I2CTransaction*);      // Enqueue without blocking. Fails if the queue is full.
+      int    await(I2CTransaction*);       // Block until a submitted transaction completes. Returns its result.
+      void   drain(void);                  // Block until the queue is empty and the bus is idle.
+      uint32_t asyncFailures(void);        // Count of fire-and-forget writes that failed on the bus thread.
+#endif
       
       void setDebug(bool);
 
+      static const int8_t I2C_ADAPTER_ERROR_NO_ERROR;
+      static const int8_t I2C_ADAPTER_ERROR_QUEUE_FULL;    // The bus worker's queue has no room.
+      static const int8_t I2C_ADAPTER_ERROR_NO_WORKER;     // Asynchronous operation was requested, but the bus worker isn't running.
+
 
     private:
-      bool bus_online;
-      bool bus_in_use;
+      bool bus_in_use;                      // Read from any thread by busIdle(). Only touch it atomically.
+      bool bus_error;                       // Written by whichever thread ran the I/O. Only touch it atomically.
       bool debug;
-      
-      uint8_t last_used_bus_addr;
+
+      I2CTransport* transport;
+      bool          own_transport;          // True if we built the transport, and so must destroy it.
+
+      int execute(I2CTransaction*);         // Actually does the I/O. Caller must hold bus_mutex.
+      void init_state(void);
 #ifndef ARDUINO
-      int open_bus_descriptor;
+      void log_transaction(I2CTransaction*);
+
+      pthread_mutex_t bus_mutex;            // Held for the duration of any I/O.
+      pthread_mutex_t queue_mutex;
+      pthread_cond_t  queue_nonempty;
+      pthread_cond_t  queue_changed;        // Signalled on completion and when a slot frees up.
+      pthread_t       worker_thread;
+      bool            worker_running;       // Read from any thread. Only touch it atomically.
+      uint8_t         queue_depth;
+      uint8_t         queue_head;
+      uint8_t         queue_count;
+      bool            worker_busy;
+      uint32_t        async_failures;
+      I2CTransaction* queue[I2C_WORKER_MAX_QUEUE];
+
+      int8_t enqueue(I2CTransaction*);      // submit(), but waits for room in the queue.
+      bool on_worker_thread(void);
+      static void* worker_loop(void*);
 #endif
-
-      bool switch_device(uint8_t);      // Call this to switch to another i2c device on the bus.
   };
 
 #endif
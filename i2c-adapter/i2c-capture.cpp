@@ -0,0 +1,290 @@
+/*
+File:   i2c-capture.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef ARDUINO
+
+#include "i2c-capture.h"
+#include "i2c-sim.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+
+#define I2C_CAPTURE_RECORD_HEADER   15    // start, duration, result, segment count.
+#define I2C_CAPTURE_SEGMENT_HEADER  4     // address, flags, length.
+
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+
+/**************************************************************************
+* Recording...                                                            *
+**************************************************************************/
+
+I2CRecordTransport::I2CRecordTransport(I2CTransport *xport, const char *path) {
+	inner        = xport;
+	record_count = 0;
+	epoch_ns     = monotonic_ns();
+	capture      = fopen(path, "wb");
+	if (NULL != capture) {
+		uint8_t version = I2C_CAPTURE_VERSION;
+		fwrite(I2C_CAPTURE_MAGIC, 1, 7, capture);
+		fwrite(&version, 1, 1, capture);
+	}
+	else {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to open %s for capture. Traffic will pass, but not be recorded.", path);
+	}
+}
+
+
+I2CRecordTransport::~I2CRecordTransport() {
+	if (NULL != capture) {
+		fclose(capture);
+		capture = NULL;
+	}
+}
+
+
+bool I2CRecordTransport::busOnline(void) {
+	return ((NULL != inner) && inner->busOnline());
+}
+
+
+void I2CRecordTransport::flush(void) {
+	if (NULL != capture) fflush(capture);
+}
+
+
+uint32_t I2CRecordTransport::recorded(void) {
+	return record_count;
+}
+
+
+/*
+* The record is written after the fact, so that read segments carry what came back.
+*/
+int I2CRecordTransport::execute(I2CTransaction *txn) {
+	uint64_t start = monotonic_ns();
+	int ret = inner->execute(txn);
+	uint32_t duration = (uint32_t) (monotonic_ns() - start);
+
+	if (NULL != capture) {
+		uint64_t rel    = start - epoch_ns;
+		int16_t  result = (int16_t) ret;
+		fwrite(&rel, sizeof(rel), 1, capture);
+		fwrite(&duration, sizeof(duration), 1, capture);
+		fwrite(&result, sizeof(result), 1, capture);
+		fwrite(&txn->seg_count, 1, 1, capture);
+		for (uint8_t i = 0; i < txn->seg_count; i++) {
+			I2CSegment *seg = &txn->segments[i];
+			fwrite(&seg->dev_addr, 1, 1, capture);
+			fwrite(&seg->flags, 1, 1, capture);
+			fwrite(&seg->len, sizeof(seg->len), 1, capture);
+			fwrite(seg->buf, 1, seg->len, capture);
+		}
+		record_count++;
+	}
+	return ret;
+}
+
+
+/**************************************************************************
+* Replay...                                                               *
+**************************************************************************/
+
+I2CReplayTransport::I2CReplayTransport(const char *path) {
+	image        = NULL;
+	image_len    = 0;
+	offsets      = NULL;
+	record_count = 0;
+	cursor       = 0;
+	clock_hz     = 100000;
+	stat_transactions = 0;
+	stat_bytes        = 0;
+	stat_wire_us      = 0;
+	stat_captured_ns  = 0;
+	stat_divergences  = 0;
+
+	FILE *fp = fopen(path, "rb");
+	if (NULL == fp) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to open capture %s.", path);
+		return;
+	}
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (len >= 8) {     // Just the header is a capture of nothing.
+		image = (uint8_t*) malloc(len);
+		if ((NULL != image) && (fread(image, 1, len, fp) == (size_t) len)) {
+			image_len = len;
+		}
+	}
+	fclose(fp);
+
+	if ((image_len < 8) || (memcmp(image, I2C_CAPTURE_MAGIC, 7) != 0) || (image[7] != I2C_CAPTURE_VERSION)) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "%s is not a capture we can replay.", path);
+		image_len = 0;
+		return;
+	}
+	if (!index_image()) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_WARNING, "%s is truncated. Replaying the first %u records.", path, record_count);
+	}
+}
+
+
+I2CReplayTransport::~I2CReplayTransport() {
+	if (NULL != image)   free(image);
+	if (NULL != offsets) free(offsets);
+}
+
+
+/*
+* Walk the image once so that we can jump straight to any record later.
+*   Returns false if the image ends part-way through a record.
+*/
+bool I2CReplayTransport::index_image(void) {
+	uint32_t capacity = 256;
+	uint32_t pos = 8;
+	offsets = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+	while (pos < image_len) {
+		if ((pos + I2C_CAPTURE_RECORD_HEADER) > image_len) return false;
+		uint32_t rec_start = pos;
+		uint8_t segs = image[pos + 14];
+		pos += I2C_CAPTURE_RECORD_HEADER;
+		for (uint8_t i = 0; i < segs; i++) {
+			if ((pos + I2C_CAPTURE_SEGMENT_HEADER) > image_len) return false;
+			uint16_t len;
+			memcpy(&len, &image[pos + 2], sizeof(len));
+			pos += I2C_CAPTURE_SEGMENT_HEADER + len;
+		}
+		if (pos > image_len) return false;
+		if (record_count == capacity) {
+			capacity = capacity * 2;
+			offsets = (uint32_t*) realloc(offsets, capacity * sizeof(uint32_t));
+		}
+		offsets[record_count++] = rec_start;
+	}
+	return true;
+}
+
+
+bool I2CReplayTransport::busOnline(void) {
+	return (image_len > 0);
+}
+
+
+/*
+* A record matches if it has the same shape (addresses, directions, lengths) and
+*   every write carries the same payload.
+*/
+bool I2CReplayTransport::matches(uint32_t record, I2CTransaction *txn) {
+	uint32_t pos = offsets[record];
+	if (image[pos + 14] != txn->seg_count) return false;
+	pos += I2C_CAPTURE_RECORD_HEADER;
+	for (uint8_t i = 0; i < txn->seg_count; i++) {
+		I2CSegment *seg = &txn->segments[i];
+		uint16_t len;
+		memcpy(&len, &image[pos + 2], sizeof(len));
+		if ((image[pos] != seg->dev_addr) || (image[pos + 1] != seg->flags) || (len != seg->len)) return false;
+		pos += I2C_CAPTURE_SEGMENT_HEADER;
+		if (!(seg->flags & I2C_SEG_FLAG_READ) && (memcmp(&image[pos], seg->buf, len) != 0)) return false;
+		pos += len;
+	}
+	return true;
+}
+
+
+int I2CReplayTransport::serve(uint32_t record, I2CTransaction *txn) {
+	uint32_t pos = offsets[record];
+	uint32_t duration;
+	int16_t  result;
+	memcpy(&duration, &image[pos + 8], sizeof(duration));
+	memcpy(&result, &image[pos + 12], sizeof(result));
+	pos += I2C_CAPTURE_RECORD_HEADER;
+	for (uint8_t i = 0; i < txn->seg_count; i++) {
+		I2CSegment *seg = &txn->segments[i];
+		pos += I2C_CAPTURE_SEGMENT_HEADER;
+		if (seg->flags & I2C_SEG_FLAG_READ) memcpy(seg->buf, &image[pos], seg->len);
+		pos += seg->len;
+	}
+	stat_captured_ns += duration;
+	txn->result = result;
+	return txn->result;
+}
+
+
+/*
+* If the drivers ask for what the capture says comes next, they get what the hardware
+*   said. If not, we look a little way ahead for it, in case the code under test merely
+*   skipped something. Failing that, the transaction is counted as a divergence and
+*   answered as a quiet bus would: writes succeed, and reads come back as zeros.
+*/
+int I2CReplayTransport::execute(I2CTransaction *txn) {
+	stat_transactions++;
+	stat_bytes   += txn->byteCount();
+	stat_wire_us += I2CSimTransport::wireMicros(txn, clock_hz);
+
+	for (uint32_t i = cursor; (i < record_count) && (i < cursor + I2C_REPLAY_LOOKAHEAD); i++) {
+		if (matches(i, txn)) {
+			cursor = i + 1;
+			return serve(i, txn);
+		}
+	}
+
+	if (0 == stat_divergences) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_WARNING, "Traffic diverged from the capture at record %u.", cursor);
+	}
+	stat_divergences++;
+	for (uint8_t i = 0; i < txn->seg_count; i++) {
+		if (txn->segments[i].flags & I2C_SEG_FLAG_READ) memset(txn->segments[i].buf, 0x00, txn->segments[i].len);
+	}
+	txn->result = txn->seg_count;
+	return txn->result;
+}
+
+
+void     I2CReplayTransport::setClock(uint32_t bus_hz) {  if (bus_hz > 0) clock_hz = bus_hz;  }
+uint32_t I2CReplayTransport::transactions(void) {         return stat_transactions;        }
+uint32_t I2CReplayTransport::bytes(void) {                return stat_bytes;               }
+uint64_t I2CReplayTransport::wireMicros(void) {           return stat_wire_us;             }
+uint64_t I2CReplayTransport::capturedNanos(void) {        return stat_captured_ns;         }
+uint32_t I2CReplayTransport::divergences(void) {          return stat_divergences;         }
+uint32_t I2CReplayTransport::remaining(void) {            return record_count - cursor;    }
+
+
+void I2CReplayTransport::dumpToLog(void) {
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Replayed %u transactions (%u bytes). %lu us on the wire at %u Hz, %lu us as captured.",
+		stat_transactions, stat_bytes, (unsigned long) stat_wire_us, clock_hz, (unsigned long) (stat_captured_ns / 1000));
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "%u divergences. %u of %u captured records left unconsumed.", stat_divergences, remaining(), record_count);
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,112 @@
+/*
+File:   i2c-capture.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+Bus traffic capture and replay.
+
+I2CRecordTransport sits in front of any other transport and writes every
+transaction it passes along to a capture file. I2CReplayTransport reads that
+file back and answers the drivers as the hardware did, with no hardware.
+
+Capture format (host byte order):
+  Header:   "VSI2CAP" and a version byte.
+  Record:   uint64 start (ns since capture began, CLOCK_MONOTONIC)
+            uint32 duration (ns)
+            int16  result (as returned by the transport)
+            uint8  segment count
+            then, per segment:
+              uint8 address, uint8 flags, uint16 length, <length> bytes
+  Written segments carry their payload. Read segments carry what came back.
+*/
+
+
+#ifndef I2C_CAPTURE_TRANSPORT_H
+  #define I2C_CAPTURE_TRANSPORT_H 1
+
+#ifndef ARDUINO
+  #include "i2c-transport.h"
+  #include <stdio.h>
+
+  #define I2C_CAPTURE_MAGIC       "VSI2CAP"
+  #define I2C_CAPTURE_VERSION     1
+  #define I2C_REPLAY_LOOKAHEAD    16     // How far ahead replay will look to resync after a divergence.
+
+
+  class I2CRecordTransport : public I2CTransport {
+    public:
+      I2CRecordTransport(I2CTransport *inner, const char *path);   // We do not take ownership of inner.
+      ~I2CRecordTransport(void);
+
+      bool busOnline(void);
+      int  execute(I2CTransaction*);
+      void flush(void);
+
+      uint32_t recorded(void);        // Transactions written to the capture.
+
+    private:
+      I2CTransport* inner;
+      FILE*    capture;
+      uint64_t epoch_ns;
+      uint32_t record_count;
+  };
+
+
+  class I2CReplayTransport : public I2CTransport {
+    public:
+      I2CReplayTransport(const char *path);
+      ~I2CReplayTransport(void);
+
+      bool busOnline(void);
+      int  execute(I2CTransaction*);
+
+      void     setClock(uint32_t bus_hz);   // The clock used to cost the replayed traffic.
+
+      uint32_t transactions(void);     // Transactions the drivers asked for.
+      uint32_t bytes(void);            // Payload bytes the drivers asked for.
+      uint64_t wireMicros(void);       // What that would have cost on the wire at our clock.
+      uint64_t capturedNanos(void);    // What the matched records actually took when captured.
+      uint32_t divergences(void);      // Transactions that didn't line up with the capture.
+      uint32_t remaining(void);        // Records not yet consumed.
+      void     dumpToLog(void);
+
+    private:
+      uint8_t* image;                  // The whole capture, in memory.
+      uint32_t image_len;
+      uint32_t* offsets;               // Where each record starts in the image.
+      uint32_t record_count;
+      uint32_t cursor;                 // Index of the next record we expect to see.
+      uint32_t clock_hz;
+
+      uint32_t stat_transactions;
+      uint32_t stat_bytes;
+      uint64_t stat_wire_us;
+      uint64_t stat_captured_ns;
+      uint32_t stat_divergences;
+
+      bool index_image(void);
+      bool matches(uint32_t record, I2CTransaction*);
+      int  serve(uint32_t record, I2CTransaction*);
+  };
+
+#endif  // ARDUINO
+#endif
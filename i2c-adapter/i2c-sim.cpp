@@ -0,0 +1,289 @@
+/*
+File:   i2c-sim.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "i2c-sim.h"
+#include <string.h>
+
+#include "../Logger/Logger.h"
+extern IansLogger logger;
+
+
+const int8_t I2CSimTransport::I2C_SIM_ERROR_NO_ERROR     = 0;
+const int8_t I2CSimTransport::I2C_SIM_ERROR_FULL         = -1;
+const int8_t I2CSimTransport::I2C_SIM_ERROR_ADDR_IN_USE  = -2;
+
+
+/**************************************************************************
+* ADG2128                                                                 *
+**************************************************************************/
+
+/*
+* The first byte the driver writes to select each row for readback. Must agree
+*   with ADG2128::readback_addr.
+*/
+static const uint8_t adg2128_readback_sel[12] = {0x34, 0x3b, 0x74, 0x7b, 0x35, 0x3d, 0x75, 0x7d, 0x36, 0x3e, 0x76, 0x7e};
+
+
+SimADG2128::SimADG2128(uint8_t addr) : I2CSimDevice(addr) {
+	memset(live, 0x00, sizeof(live));           // Power-on state is all switches open.
+	memset(pending, 0x00, sizeof(pending));
+	readback_row = -1;
+	latches = 0;
+}
+
+
+int SimADG2128::write(const uint8_t *buf, uint16_t len) {
+	if (len < 2) return len;   // The part ACKs a short write, but does nothing with it.
+
+	for (uint8_t i = 0; i < 12; i++) {
+		if (buf[0] == adg2128_readback_sel[i]) {
+			readback_row = i;
+			return len;
+		}
+	}
+
+	uint8_t ax = (buf[0] >> 3) & 0x0F;
+	uint8_t ay = buf[0] & 0x07;
+	int8_t  r  = -1;
+	if (ax <= 5) r = ax;
+	else if ((ax >= 8) && (ax <= 13)) r = ax - 2;
+
+	if (r >= 0) {
+		if (buf[0] & 0x80) pending[r] = pending[r] | (0x01 << ay);
+		else               pending[r] = pending[r] & ~(0x01 << ay);
+	}
+	if (buf[1] & 0x01) {    // LDSW
+		memcpy(live, pending, sizeof(live));
+		latches++;
+	}
+	return len;
+}
+
+
+int SimADG2128::read(uint8_t *buf, uint16_t len) {
+	memset(buf, 0x00, len);
+	if ((readback_row >= 0) && (len >= 2)) {
+		buf[1] = live[readback_row];
+	}
+	return len;
+}
+
+
+uint8_t  SimADG2128::row(uint8_t r) {         return (r < 12) ? live[r] : 0;     }
+uint8_t  SimADG2128::pendingRow(uint8_t r) {  return (r < 12) ? pending[r] : 0;  }
+uint32_t SimADG2128::latchCount(void) {       return latches;                    }
+
+
+void SimADG2128::dumpToLog(void) {
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Simulated ADG2128 at 0x%02x. %u latches.", address, latches);
+	for (int i = 0; i < 12; i++) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "  Row %d: 0x%02x (pending 0x%02x)", i, live[i], pending[i]);
+	}
+}
+
+
+/**************************************************************************
+* ISL23345                                                                *
+**************************************************************************/
+
+SimISL23345::SimISL23345(uint8_t addr) : I2CSimDevice(addr) {
+	for (int i = 0; i < 4; i++) wipers[i] = 0x80;   // Power-on is mid-scale.
+	acr_reg = 0x40;
+	pointer = 0;
+}
+
+
+bool SimISL23345::reg_valid(uint8_t reg) {
+	return ((reg < 4) || (reg == 0x10));
+}
+
+
+uint8_t* SimISL23345::reg_ptr(uint8_t reg) {
+	return (reg < 4) ? &wipers[reg] : &acr_reg;
+}
+
+
+/*
+* Sequential access walks the wiper registers and wraps. ACR stands alone.
+*/
+void SimISL23345::advance(void) {
+	if (pointer < 4) pointer = (pointer + 1) % 4;
+}
+
+
+int SimISL23345::write(const uint8_t *buf, uint16_t len) {
+	if (len == 0) return 0;
+	pointer = buf[0];
+	for (uint16_t i = 1; i < len; i++) {
+		if (!reg_valid(pointer)) return -1;
+		if (pointer == 0x10) {
+			acr_reg = buf[i] & 0xC0;     // WIP (bit 5) is read-only, and the rest is reserved.
+		}
+		else {
+			*reg_ptr(pointer) = buf[i];
+		}
+		advance();
+	}
+	return len;
+}
+
+
+int SimISL23345::read(uint8_t *buf, uint16_t len) {
+	for (uint16_t i = 0; i < len; i++) {
+		if (!reg_valid(pointer)) return -1;
+		buf[i] = *reg_ptr(pointer);
+		advance();
+	}
+	return len;
+}
+
+
+uint8_t SimISL23345::wiper(uint8_t pot) {  return (pot < 4) ? wipers[pot] : 0;  }
+uint8_t SimISL23345::acr(void) {           return acr_reg;                      }
+
+
+void SimISL23345::dumpToLog(void) {
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Simulated ISL23345 at 0x%02x. ACR: 0x%02x", address, acr_reg);
+	for (int i = 0; i < 4; i++) {
+		logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "  WR%d: 0x%02x", i, wipers[i]);
+	}
+}
+
+
+/**************************************************************************
+* The simulated bus...                                                    *
+**************************************************************************/
+
+I2CSimTransport::I2CSimTransport(uint32_t bus_hz) {
+	device_count = 0;
+	clock_hz     = (bus_hz > 0) ? bus_hz : 100000;
+	for (int i = 0; i < I2C_SIM_MAX_DEVICES; i++) devices[i] = NULL;
+	resetStats();
+}
+
+
+I2CSimTransport::~I2CSimTransport() {
+	for (int i = 0; i < device_count; i++) delete devices[i];
+}
+
+
+bool I2CSimTransport::busOnline(void) {
+	return true;
+}
+
+
+int8_t I2CSimTransport::attach(I2CSimDevice *dev) {
+	if (NULL != getDevice(dev->address)) {
+		delete dev;
+		return I2C_SIM_ERROR_ADDR_IN_USE;
+	}
+	if (device_count >= I2C_SIM_MAX_DEVICES) {
+		delete dev;
+		return I2C_SIM_ERROR_FULL;
+	}
+	devices[device_count++] = dev;
+	return I2C_SIM_ERROR_NO_ERROR;
+}
+
+
+int8_t I2CSimTransport::attachADG2128(uint8_t addr) {   return attach(new SimADG2128(addr));   }
+int8_t I2CSimTransport::attachISL23345(uint8_t addr) {  return attach(new SimISL23345(addr));  }
+
+
+I2CSimDevice* I2CSimTransport::getDevice(uint8_t addr) {
+	for (int i = 0; i < device_count; i++) {
+		if (devices[i]->address == addr) return devices[i];
+	}
+	return NULL;
+}
+
+
+/*
+* Each segment costs a START (or repeated-START), the address byte and its ACK, and
+*   nine clocks per data byte. The transaction ends with a STOP. START and STOP are
+*   counted as one bit-time apiece.
+*/
+uint32_t I2CSimTransport::wireMicros(I2CTransaction *txn, uint32_t bus_hz) {
+	uint64_t bits = 1;
+	for (uint8_t i = 0; i < txn->seg_count; i++) {
+		bits += 1 + 9 + (9 * (uint64_t) txn->segments[i].len);
+	}
+	return (uint32_t) (((bits * 1000000) + bus_hz - 1) / bus_hz);
+}
+
+
+/*
+* Segments are played against the devices in order. As on a real bus, anything
+*   that happened before a NACK stays happened.
+*/
+int I2CSimTransport::execute(I2CTransaction *txn) {
+	txn->result = -1;
+	stat_last_micros = wireMicros(txn, clock_hz);
+	stat_micros += stat_last_micros;
+	stat_transactions++;
+
+	for (uint8_t i = 0; i < txn->seg_count; i++) {
+		I2CSegment *seg = &txn->segments[i];
+		I2CSimDevice *dev = getDevice(seg->dev_addr);
+		stat_segments++;
+		if (NULL == dev) {
+			return txn->result;     // Nobody home. NACK on the address byte.
+		}
+		int ret = (seg->flags & I2C_SEG_FLAG_READ) ? dev->read(seg->buf, seg->len) : dev->write(seg->buf, seg->len);
+		if (ret != seg->len) {
+			return txn->result;
+		}
+		stat_bytes += seg->len;
+	}
+	txn->result = txn->seg_count;
+	return txn->result;
+}
+
+
+void     I2CSimTransport::setClock(uint32_t bus_hz) {  if (bus_hz > 0) clock_hz = bus_hz;  }
+uint32_t I2CSimTransport::getClock(void) {             return clock_hz;           }
+uint32_t I2CSimTransport::transactions(void) {         return stat_transactions;  }
+uint32_t I2CSimTransport::segments(void) {             return stat_segments;      }
+uint32_t I2CSimTransport::bytes(void) {                return stat_bytes;         }
+uint64_t I2CSimTransport::busMicros(void) {            return stat_micros;        }
+uint32_t I2CSimTransport::lastMicros(void) {           return stat_last_micros;   }
+
+
+void I2CSimTransport::resetStats(void) {
+	stat_transactions = 0;
+	stat_segments     = 0;
+	stat_bytes        = 0;
+	stat_micros       = 0;
+	stat_last_micros  = 0;
+}
+
+
+void I2CSimTransport::dumpToLog(void) {
+	logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Simulated bus at %u Hz: %u transactions, %u segments, %u bytes, %lu us on the wire.",
+		clock_hz, stat_transactions, stat_segments, stat_bytes, (unsigned long) stat_micros);
+	for (int i = 0; i < device_count; i++) {
+		devices[i]->dumpToLog();
+	}
+}
@@ -0,0 +1,160 @@
+/*
+File:   i2c-sim.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+This is a register-level simulation of the ViamSonus PCB's bus. It lets the
+drivers (and everything built on them) run without the board attached.
+
+The simulated parts respond to exactly the byte sequences the real parts do,
+so anything the drivers write can be read back the way the hardware would
+report it. The transport also keeps an account of how long each transaction
+would have occupied a real bus at the configured clock rate.
+*/
+
+
+#ifndef I2C_SIMULATED_TRANSPORT_H
+  #define I2C_SIMULATED_TRANSPORT_H 1
+
+  #include "i2c-transport.h"
+
+  #define I2C_SIM_MAX_DEVICES   8
+
+
+  /*
+  * A simulated device. Gets the payload of each segment addressed to it.
+  * Both calls return the number of bytes ACK'd (or supplied), or -1 to NACK.
+  */
+  class I2CSimDevice {
+    public:
+      I2CSimDevice(uint8_t addr) : address(addr) {};
+      virtual ~I2CSimDevice(void) {};
+
+      virtual int  write(const uint8_t *buf, uint16_t len) = 0;
+      virtual int  read(uint8_t *buf, uint16_t len) = 0;
+      virtual void dumpToLog(void) = 0;
+
+      const uint8_t address;
+  };
+
+
+  /*
+  * ADG2128 8x12 crosspoint.
+  * Writes are two bytes: [DATA | AX3..AX0 | AY2..AY0] [xxxxxxx LDSW]
+  *   X addresses 0-5 and 8-13 are rows 0-11. The other X codes are readback selectors.
+  *   With LDSW clear, the change is held in the input register until a later write
+  *   sets LDSW, at which point every held change takes effect at once.
+  * Reads return two bytes: 0x00, then the state of the selected row (bit n = column n).
+  */
+  class SimADG2128 : public I2CSimDevice {
+    public:
+      SimADG2128(uint8_t addr);
+
+      int  write(const uint8_t *buf, uint16_t len);
+      int  read(uint8_t *buf, uint16_t len);
+      void dumpToLog(void);
+
+      uint8_t  row(uint8_t r);          // The live (latched) state of a row.
+      uint8_t  pendingRow(uint8_t r);   // What the row will be after the next latch.
+      uint32_t latchCount(void);        // How many times LDSW has been asserted.
+
+    private:
+      uint8_t  live[12];
+      uint8_t  pending[12];
+      int8_t   readback_row;            // -1 if no readback address has been selected.
+      uint32_t latches;
+  };
+
+
+  /*
+  * ISL23345 quad digital potentiometer.
+  * The first byte written is the address pointer. Subsequent bytes (written or read)
+  *   go to/come from the pointer, which auto-increments across WR0-WR3.
+  * ACR is at 0x10. Bit 6 set means the part is active (not shut down).
+  */
+  class SimISL23345 : public I2CSimDevice {
+    public:
+      SimISL23345(uint8_t addr);
+
+      int  write(const uint8_t *buf, uint16_t len);
+      int  read(uint8_t *buf, uint16_t len);
+      void dumpToLog(void);
+
+      uint8_t wiper(uint8_t pot);
+      uint8_t acr(void);
+
+    private:
+      uint8_t wipers[4];
+      uint8_t acr_reg;
+      uint8_t pointer;
+
+      bool reg_valid(uint8_t);
+      uint8_t* reg_ptr(uint8_t);
+      void advance(void);
+  };
+
+
+  class I2CSimTransport : public I2CTransport {
+    public:
+      I2CSimTransport(uint32_t bus_hz);
+      ~I2CSimTransport(void);
+
+      bool busOnline(void);
+      int  execute(I2CTransaction*);
+
+      int8_t attachADG2128(uint8_t addr);
+      int8_t attachISL23345(uint8_t addr);
+      I2CSimDevice* getDevice(uint8_t addr);
+
+      void     setClock(uint32_t bus_hz);  // 100000 and 400000 are the usual suspects.
+      uint32_t getClock(void);
+
+      // What the bus would have done, had it been real.
+      uint32_t transactions(void);
+      uint32_t segments(void);
+      uint32_t bytes(void);
+      uint64_t busMicros(void);            // Accumulated time on the wire.
+      uint32_t lastMicros(void);           // Time on the wire for the most recent transaction.
+      void     resetStats(void);
+      void     dumpToLog(void);
+
+      static uint32_t wireMicros(I2CTransaction*, uint32_t bus_hz);
+
+      static const int8_t I2C_SIM_ERROR_NO_ERROR;
+      static const int8_t I2C_SIM_ERROR_FULL;          // No room for another device.
+      static const int8_t I2C_SIM_ERROR_ADDR_IN_USE;   // A device already answers at that address.
+
+    private:
+      I2CSimDevice* devices[I2C_SIM_MAX_DEVICES];
+      uint8_t  device_count;
+      uint32_t clock_hz;
+
+      uint32_t stat_transactions;
+      uint32_t stat_segments;
+      uint32_t stat_bytes;
+      uint64_t stat_micros;
+      uint32_t stat_last_micros;
+
+      int8_t attach(I2CSimDevice*);
+  };
+
+#endif
@@ -0,0 +1,311 @@
+/*
+File:   i2c-transport.cpp
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "i2c-transport.h"
+#include <string.h>
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+  #ifndef I2C_T3_H
+    #include <i2c_t3.h>
+  #endif
+#else
+  #include <stdio.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <linux/i2c.h>
+  #include <linux/i2c-dev.h>
+  #include <sys/ioctl.h>
+
+  #include "../Logger/Logger.h"
+  extern IansLogger logger;
+#endif
+
+
+/**************************************************************************
+* Transactions...                                                         *
+**************************************************************************/
+
+const int8_t I2CTransaction::I2C_XFER_ERROR_NO_ERROR = 0;
+const int8_t I2CTransaction::I2C_XFER_ERROR_FULL     = -1;
+
+
+I2CTransaction::I2CTransaction() {
+    clear();
+}
+
+
+void I2CTransaction::clear(void) {
+    seg_count = 0;
+    pool_used = 0;
+    result    = -1;
+    callback     = NULL;
+    callback_arg = NULL;
+    complete     = false;
+    free_on_completion = false;
+}
+
+
+bool I2CTransaction::hasReads(void) {
+    for (uint8_t i = 0; i < seg_count; i++) {
+        if (segments[i].flags & I2C_SEG_FLAG_READ) return true;
+    }
+    return false;
+}
+
+
+/*
+* Write payloads are re-homed into our own pool. Read segments keep pointing at
+*   whatever buffer the source was pointing at.
+*/
+int8_t I2CTransaction::copy(I2CTransaction *src) {
+    clear();
+    for (uint8_t i = 0; i < src->seg_count; i++) {
+        I2CSegment *seg = &src->segments[i];
+        int8_t ret = (seg->flags & I2C_SEG_FLAG_READ) ? addRead(seg->dev_addr, seg->buf, seg->len) : addWrite(seg->dev_addr, seg->buf, seg->len);
+        if (ret != I2C_XFER_ERROR_NO_ERROR) return ret;
+    }
+    return I2C_XFER_ERROR_NO_ERROR;
+}
+
+
+uint8_t I2CTransaction::segmentCount(void) {
+    return seg_count;
+}
+
+
+uint16_t I2CTransaction::byteCount(void) {
+    uint16_t return_value = 0;
+    for (uint8_t i = 0; i < seg_count; i++) {
+        return_value += segments[i].len;
+    }
+    return return_value;
+}
+
+
+bool I2CTransaction::full(uint8_t segs, uint16_t bytes) {
+    return (((seg_count + segs) > I2C_XFER_MAX_SEGMENTS) || ((pool_used + bytes) > I2C_XFER_POOL_SIZE));
+}
+
+
+int8_t I2CTransaction::addWrite(uint8_t dev_addr, const uint8_t *buf, uint16_t len) {
+    if (full(1, len)) return I2C_XFER_ERROR_FULL;
+    I2CSegment *seg = &segments[seg_count++];
+    seg->dev_addr = dev_addr;
+    seg->flags    = 0;
+    seg->len      = len;
+    seg->buf      = &pool[pool_used];
+    memcpy(seg->buf, buf, len);
+    pool_used += len;
+    return I2C_XFER_ERROR_NO_ERROR;
+}
+
+
+int8_t I2CTransaction::addWrite8(uint8_t dev_addr, uint8_t dat) {
+    return addWrite(dev_addr, &dat, 1);
+}
+
+
+int8_t I2CTransaction::addWrite16(uint8_t dev_addr, uint16_t dat) {
+    uint8_t buffer[2];
+    buffer[0] = (dat & 0xFF00) >> 8;
+    buffer[1] = dat & 0x00FF;
+    return addWrite(dev_addr, buffer, 2);
+}
+
+
+int8_t I2CTransaction::addRead(uint8_t dev_addr, uint8_t *buf, uint16_t len) {
+    if (full(1, 0)) return I2C_XFER_ERROR_FULL;
+    I2CSegment *seg = &segments[seg_count++];
+    seg->dev_addr = dev_addr;
+    seg->flags    = I2C_SEG_FLAG_READ;
+    seg->len      = len;
+    seg->buf      = buf;
+    return I2C_XFER_ERROR_NO_ERROR;
+}
+
+
+
+#ifndef ARDUINO
+/**************************************************************************
+* The linux i2c-dev transport...                                          *
+**************************************************************************/
+
+LinuxI2CTransport::LinuxI2CTransport(uint8_t bus_id) {
+    rdwr_supported      = false;
+    last_used_bus_addr  = 0;
+    open_bus_descriptor = -1;
+
+    char *filename = (char *) alloca(24);
+    if (sprintf(filename, "/dev/i2c-%d", bus_id) > 0) {
+        open_bus_descriptor = open(filename, O_RDWR);
+        if (open_bus_descriptor >= 0) {
+            // Combined transactions need a plain-i2c adapter. SMBus-only hardware gets the slow path.
+            unsigned long funcs = 0;
+            if (ioctl(open_bus_descriptor, I2C_FUNCS, &funcs) >= 0) {
+                rdwr_supported = ((funcs & I2C_FUNC_I2C) != 0);
+            }
+            if (!rdwr_supported) {
+                logger.unified_log(__PRETTY_FUNCTION__, LOG_NOTICE, "%s does not support I2C_RDWR. Transactions will not be combined.", filename);
+            }
+        }
+        else {
+            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to open the i2c bus represented by %s.", filename);
+        }
+    }
+    else {
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Somehow we failed to sprintf and build a filename to open i2c bus %d.", bus_id);
+    }
+}
+
+
+LinuxI2CTransport::~LinuxI2CTransport() {
+    if (open_bus_descriptor >= 0) {
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_INFO, "Closing the open i2c bus...");
+        close(open_bus_descriptor);
+        open_bus_descriptor = -1;
+    }
+}
+
+
+bool LinuxI2CTransport::busOnline(void) {
+    return (open_bus_descriptor >= 0);
+}
+
+
+/*
+* Every segment goes out in a single ioctl(), with a repeated-start between each one.
+*   Since each i2c_msg carries its own address, there is no need to ioctl(I2C_SLAVE)
+*   when the transaction talks to more than one device.
+*/
+int LinuxI2CTransport::execute(I2CTransaction *txn) {
+    txn->result = -1;
+    if (!rdwr_supported) {
+        return execute_legacy(txn);
+    }
+
+    struct i2c_msg msgs[I2C_XFER_MAX_SEGMENTS];
+    struct i2c_rdwr_ioctl_data rdwr;
+    for (uint8_t i = 0; i < txn->seg_count; i++) {
+        msgs[i].addr  = txn->segments[i].dev_addr;
+        msgs[i].flags = (txn->segments[i].flags & I2C_SEG_FLAG_READ) ? I2C_M_RD : 0;
+        msgs[i].len   = txn->segments[i].len;
+        msgs[i].buf   = txn->segments[i].buf;
+    }
+    rdwr.msgs  = msgs;
+    rdwr.nmsgs = txn->seg_count;
+
+    int ret = ioctl(open_bus_descriptor, I2C_RDWR, &rdwr);
+    if (ret == txn->seg_count) {
+        txn->result = ret;
+    }
+    else {
+        logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Combined transfer of %d segments failed (%d).", txn->seg_count, ret);
+    }
+    return txn->result;
+}
+
+
+/*
+* For adapters that can't do I2C_RDWR (SMBus-only controllers), we do it the old way:
+*   one write() or read() per segment, with a STOP between each.
+*/
+int LinuxI2CTransport::execute_legacy(I2CTransaction *txn) {
+    for (uint8_t i = 0; i < txn->seg_count; i++) {
+        I2CSegment *seg = &txn->segments[i];
+        if (!switch_device(seg->dev_addr)) {
+            return txn->result;
+        }
+        int ret = (seg->flags & I2C_SEG_FLAG_READ) ? read(open_bus_descriptor, seg->buf, seg->len) : write(open_bus_descriptor, seg->buf, seg->len);
+        if (ret != seg->len) {
+            logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to %s %d bytes on the i2c bus.", ((seg->flags & I2C_SEG_FLAG_READ) ? "read" : "write"), seg->len);
+            return txn->result;
+        }
+    }
+    txn->result = txn->seg_count;
+    return txn->result;
+}
+
+
+/*
+* Switch the addressed i2c device via ioctl. Only needed on the legacy path.
+*   Returns true if the ioctl call succeeded.
+*/
+bool LinuxI2CTransport::switch_device(uint8_t nu_addr) {
+    if (nu_addr == last_used_bus_addr) return true;
+    if (ioctl(open_bus_descriptor, I2C_SLAVE, nu_addr) >= 0) {
+        last_used_bus_addr = nu_addr;
+        return true;
+    }
+    logger.unified_log(__PRETTY_FUNCTION__, LOG_ERR, "Failed to acquire bus access and/or talk to slave at %d.", nu_addr);
+    return false;
+}
+
+
+#else
+/**************************************************************************
+* The Teensy3 transport...                                                *
+**************************************************************************/
+
+WireI2CTransport::WireI2CTransport() {
+    Wire.begin(I2C_MASTER, 0x00, I2C_PINS_18_19, I2C_PULLUP_EXT, I2C_RATE_400);
+}
+
+
+bool WireI2CTransport::busOnline(void) {
+    return true;
+}
+
+
+/*
+* Consecutive segments are joined with I2C_NOSTOP, so the whole transaction
+*   goes out with repeated-starts and a single STOP at the end.
+*/
+int WireI2CTransport::execute(I2CTransaction *txn) {
+    txn->result = -1;
+    for (uint8_t i = 0; i < txn->seg_count; i++) {
+        I2CSegment *seg = &txn->segments[i];
+        i2c_stop stop = ((i + 1) == txn->seg_count) ? I2C_STOP : I2C_NOSTOP;
+        if (seg->flags & I2C_SEG_FLAG_READ) {
+            Wire.requestFrom(seg->dev_addr, (size_t) seg->len, stop);
+            if (Wire.available() != seg->len) {
+                return txn->result;
+            }
+            for (uint16_t j = 0; j < seg->len; j++) {
+                seg->buf[j] = Wire.readByte();
+            }
+        }
+        else {
+            Wire.beginTransmission(seg->dev_addr);
+            Wire.write(seg->buf, seg->len);
+            if (Wire.endTransmission(stop) != 0) {
+                return txn->result;
+            }
+        }
+    }
+    txn->result = txn->seg_count;
+    return txn->result;
+}
+#endif
@@ -0,0 +1,147 @@
+/*
+File:   i2c-transport.h
+Author: ViamSonus contributors
+Date:   2026.10.17
+
+
+Copyright (C) 2026 ViamSonus contributors
+All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+A transport is the thing underneath I2CAdapter that actually moves bytes. The
+adapter builds transactions and decides when to run them (inline, or on its
+bus worker). The transport only knows how to put one transaction on the wire.
+
+To support a new platform (or to fake one), implement I2CTransport and hand an
+instance to the I2CAdapter constructor.
+*/
+
+
+#ifndef I2C_TRANSPORT_LAYER_H
+  #define I2C_TRANSPORT_LAYER_H 1
+
+  #include <inttypes.h>
+  #include <stdint.h>
+  #include <stdlib.h>
+
+  /*
+  * A transaction is an ordered list of read and write segments, possibly addressed to
+  *   several devices, that the adapter will put on the bus as a single combined message.
+  *   On linux, that means one ioctl(I2C_RDWR) with repeated-starts between the segments,
+  *   rather than a write() and a read() per register.
+  *
+  * Write payloads are copied into the transaction's own pool, so the caller need not
+  *   keep them alive. Read segments point at caller-owned buffers, which must outlive
+  *   the call to I2CAdapter::transact().
+  */
+  #define I2C_XFER_MAX_SEGMENTS   32     // Must not exceed the kernel's I2C_RDWR_IOCTL_MAX_MSGS (42).
+  #define I2C_XFER_POOL_SIZE      128    // Bytes of write payload a single transaction can carry.
+
+  #define I2C_SEG_FLAG_READ       0x01   // This segment reads from the device.
+
+  typedef struct i2c_xfer_segment_t {
+    uint8_t   dev_addr;      // 7-bit address of the device this segment talks to.
+    uint8_t   flags;         // I2C_SEG_FLAG_*
+    uint16_t  len;           // Bytes to move.
+    uint8_t*  buf;           // Write payload (in the pool), or the caller's read buffer.
+  } I2CSegment;
+
+
+  class I2CTransaction;
+  typedef void (*I2CCallback)(I2CTransaction*, void*);    // Completion callback for asynchronous transactions.
+
+
+  class I2CTransaction {
+    public:
+      I2CTransaction(void);
+
+      void clear(void);                                            // Empty the transaction so it can be re-used.
+      int8_t addWrite(uint8_t dev_addr, const uint8_t *buf, uint16_t len);
+      int8_t addWrite8(uint8_t dev_addr, uint8_t dat);
+      int8_t addWrite16(uint8_t dev_addr, uint16_t dat);           // MSB first.
+      int8_t addRead(uint8_t dev_addr, uint8_t *buf, uint16_t len);
+
+      uint8_t segmentCount(void);
+      uint16_t byteCount(void);                                    // Payload bytes across all segments.
+      bool full(uint8_t segs, uint16_t bytes);                     // Would adding this much overflow us?
+      bool hasReads(void);
+      int8_t copy(I2CTransaction*);                                // Replace our contents with those of another.
+
+      I2CSegment segments[I2C_XFER_MAX_SEGMENTS];
+      uint8_t    seg_count;
+      int        result;                                           // Segments completed, or -1 on failure.
+
+      // Only meaningful for transactions handed to I2CAdapter::submit().
+      I2CCallback callback;                                        // Called from the bus thread on completion. May be NULL.
+      void*       callback_arg;
+      bool        complete;                                        // Set by the bus thread. Use I2CAdapter::await() to block on it.
+      bool        free_on_completion;                              // The bus thread will delete this transaction when done.
+
+      static const int8_t I2C_XFER_ERROR_NO_ERROR;
+      static const int8_t I2C_XFER_ERROR_FULL;                      // Ran out of segments or pool.
+
+    private:
+      uint16_t   pool_used;
+      uint8_t    pool[I2C_XFER_POOL_SIZE];
+  };
+
+
+  class I2CTransport {
+    public:
+      virtual ~I2CTransport(void) {};
+
+      virtual bool busOnline(void) = 0;
+      // Put every segment of the transaction on the bus, in order, as one combined message.
+      // Returns the number of segments transferred, or -1 on failure.
+      virtual int  execute(I2CTransaction*) = 0;
+  };
+
+
+#ifndef ARDUINO
+  /*
+  * The linux i2c-dev backend. Talks to /dev/i2c-N.
+  */
+  class LinuxI2CTransport : public I2CTransport {
+    public:
+      LinuxI2CTransport(uint8_t bus_id);
+      ~LinuxI2CTransport(void);
+
+      bool busOnline(void);
+      int  execute(I2CTransaction*);
+
+    private:
+      int     open_bus_descriptor;
+      bool    rdwr_supported;           // False if the adapter can't do I2C_RDWR, and we must fall back to write()/read().
+      uint8_t last_used_bus_addr;
+
+      int  execute_legacy(I2CTransaction*);
+      bool switch_device(uint8_t);      // Call this to switch to another i2c device on the bus.
+  };
+#else
+  /*
+  * The Teensy3 backend, by way of i2c_t3.
+  */
+  class WireI2CTransport : public I2CTransport {
+    public:
+      WireI2CTransport(void);
+
+      bool busOnline(void);
+      int  execute(I2CTransaction*);
+  };
+#endif
+
+#endif